@@ -30,6 +30,21 @@ bool Bounds::DoesIntersect( const Bounds & rhs ) const {
 	return true;
 }
 
+/*
+====================================================
+Bounds::Contains
+====================================================
+*/
+bool Bounds::Contains( const Bounds & rhs ) const {
+	if ( rhs.mins.x < mins.x || rhs.mins.y < mins.y || rhs.mins.z < mins.z ) {
+		return false;
+	}
+	if ( rhs.maxs.x > maxs.x || rhs.maxs.y > maxs.y || rhs.maxs.z > maxs.z ) {
+		return false;
+	}
+	return true;
+}
+
 /*
 ====================================================
 Bounds::Expand
@@ -76,4 +91,44 @@ Bounds::Expand
 void Bounds::Expand( const Bounds & rhs ) {
 	Expand( rhs.mins );
 	Expand( rhs.maxs );
-}
\ No newline at end of file
+}
+
+/*
+====================================================
+boundsArray_t::Resize
+====================================================
+*/
+void boundsArray_t::Resize( const int num ) {
+	minX.resize( num );
+	minY.resize( num );
+	minZ.resize( num );
+	maxX.resize( num );
+	maxY.resize( num );
+	maxZ.resize( num );
+}
+
+/*
+====================================================
+boundsArray_t::Set
+====================================================
+*/
+void boundsArray_t::Set( const int idx, const Bounds & bounds ) {
+	minX[ idx ] = bounds.mins.x;
+	minY[ idx ] = bounds.mins.y;
+	minZ[ idx ] = bounds.mins.z;
+	maxX[ idx ] = bounds.maxs.x;
+	maxY[ idx ] = bounds.maxs.y;
+	maxZ[ idx ] = bounds.maxs.z;
+}
+
+/*
+====================================================
+boundsArray_t::Get
+====================================================
+*/
+Bounds boundsArray_t::Get( const int idx ) const {
+	Bounds bounds;
+	bounds.mins = Vec3( minX[ idx ], minY[ idx ], minZ[ idx ] );
+	bounds.maxs = Vec3( maxX[ idx ], maxY[ idx ], maxZ[ idx ] );
+	return bounds;
+}
@@ -21,6 +21,7 @@ public:
 
 	void Clear() { mins = Vec3( 1e6 ); maxs = Vec3( -1e6 ); }
 	bool DoesIntersect( const Bounds & rhs ) const;
+	bool Contains( const Bounds & rhs ) const;
 	void Expand( const Vec3 * pts, const int num );
 	void Expand( const Vec3 & rhs );
 	void Expand( const Bounds & rhs );
@@ -32,4 +33,25 @@ public:
 public:
 	Vec3 mins;
 	Vec3 maxs;
-};
\ No newline at end of file
+};
+
+/*
+====================================================
+boundsArray_t
+
+Bounds of many bodies stored per axis, so that several bodies can be read or tested at once
+====================================================
+*/
+struct boundsArray_t {
+	std::vector< float > minX;
+	std::vector< float > minY;
+	std::vector< float > minZ;
+	std::vector< float > maxX;
+	std::vector< float > maxY;
+	std::vector< float > maxZ;
+
+	int Size() const { return (int)minX.size(); }
+	void Resize( const int num );
+	void Set( const int idx, const Bounds & bounds );
+	Bounds Get( const int idx ) const;
+};
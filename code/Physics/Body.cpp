@@ -2,6 +2,7 @@
 //  Body.cpp
 //
 #include "Body.h"
+#include <algorithm>
 
 /*
 ====================================================
@@ -15,7 +16,10 @@ Body::Body() :
 	m_invMass(0.0f),
 	m_elasticity(1.0f),
 	m_friction(0.0f),
-	m_shape(nullptr)
+	m_shape(nullptr),
+	m_useCCD(false),
+	m_worldBounds(nullptr),
+	m_worldBoundsIdx(-1)
 {}
 
 Vec3 Body::GetCenterOfMassWorldSpace() const
@@ -105,8 +109,21 @@ void Body::ApplyImpulse(const Vec3& point, const Vec3& impulse)
 	ApplyImpulseAngular(angularImpulse);
 }
 
+void Body::UpdateWorldBounds()
+{
+	if (m_worldBounds == nullptr)
+	{
+		return;
+	}
+
+	m_worldBounds->Set(m_worldBoundsIdx, m_shape->GetBounds(m_position, m_orientation));
+}
+
 void Body::Update(float dt_sec)
 {
+	// Bodies at rest keep their cached bounds
+	const bool isMoving = (dt_sec != 0.0f) && (m_linearVelocity.GetLengthSqr() > 0.0f || m_angularVelocity.GetLengthSqr() > 0.0f);
+
 	m_position += m_linearVelocity * dt_sec;
 
 	const Vec3 cm = GetCenterOfMassWorldSpace();
@@ -128,4 +145,43 @@ void Body::Update(float dt_sec)
 	m_orientation.Normalize();
 
 	m_position = cm + dq.RotatePoint(cmToPosition);
+
+	if (isMoving)
+	{
+		UpdateWorldBounds();
+	}
+}
+
+/*
+====================================================
+Body::UpdateUseCCD
+
+The size of the body is half its thinnest width, a body that moves less than that in a step can't pass through
+another body of its size without the two overlapping at the end of some step. The rotation may move the leading
+side of the shape faster than the center.
+====================================================
+*/
+void Body::UpdateUseCCD(const float dt_sec)
+{
+	const float speed = m_linearVelocity.GetMagnitude();
+	if (speed == 0.0f)
+	{
+		m_useCCD = false;
+		return;
+	}
+
+	const Vec3 dir = m_linearVelocity / speed;
+	const float distance = (speed + m_shape->FastestLinearSpeed(m_angularVelocity, dir)) * dt_sec;
+
+	const Bounds bounds = m_shape->GetBounds();
+	const float size = 0.5f * std::min(bounds.WidthX(), std::min(bounds.WidthY(), bounds.WidthZ()));
+	m_useCCD = distance > size;
+}
+
+Body Body::Predicted(const float dt_sec) const
+{
+	Body body = *this;
+	body.m_worldBounds = nullptr;
+	body.Update(dt_sec);
+	return body;
 }
@@ -31,6 +31,14 @@ public:
 	float m_friction;
 	Shape* m_shape;
 
+	// Set when the body may move further than its own size within a step. Pairs with such a body sweep for the time
+	// of impact, the others are only tested where the bodies are.
+	bool m_useCCD;
+
+	// Entry of the body in the world space bounds owned by the scene, refreshed whenever the body moves
+	boundsArray_t* m_worldBounds;
+	int m_worldBoundsIdx;
+
 	Vec3 GetCenterOfMassWorldSpace() const;
 	// System centered at the origin of shape's geometry
 	Vec3 GetCenterOfMassModelSpace() const;
@@ -45,5 +53,11 @@ public:
 	void ApplyImpulseAngular(const Vec3& impulse);
 	void ApplyImpulse(const Vec3& point, const Vec3& impulse);
 
+	void UpdateWorldBounds();
 	void Update(float dt_sec);
+	void UpdateUseCCD(const float dt_sec);
+
+	// Copy of the body moved forward by dt_sec and detached from the world bounds. Queries that need the body at
+	// a later time step the copy, so the body itself is never touched and other threads may read it meanwhile.
+	Body Predicted(const float dt_sec) const;
 };
\ No newline at end of file
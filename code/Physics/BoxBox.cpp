@@ -0,0 +1,314 @@
+//
+//  BoxBox.cpp
+//
+#include "BoxBox.h"
+#include "ContactClipping.h"
+#include <algorithm>
+#include <float.h>
+
+struct orientedBox_t
+{
+	Vec3 center;
+	Vec3 axes[3];
+	float extents[3];
+};
+
+enum axisType_t
+{
+	AXIS_FACE_A,
+	AXIS_FACE_B,
+	AXIS_EDGES,
+};
+
+struct boxAxis_t
+{
+	float separation;
+	Vec3 normal;	// Points from box A towards box B
+	axisType_t type;
+	int axisA;
+	int axisB;
+};
+
+// Polygons clipped against the 4 side planes of a face have at most 4 more points than they started with
+static const int MAX_BOX_CLIP_POINTS = 8;
+
+orientedBox_t GetOrientedBox(const Body* body)
+{
+	const ShapeBox* box = reinterpret_cast<const ShapeBox*>(body->m_shape);
+	const Bounds& bounds = box->m_bounds;
+
+	// Rows of the rotation matrix are the rotated basis vectors
+	const Mat3 rotation = body->m_orientation.ToMat3();
+	const Vec3 localCenter = (bounds.mins + bounds.maxs) * 0.5f;
+
+	orientedBox_t result;
+	result.center = body->m_position + body->m_orientation.RotatePoint(localCenter);
+	for (int i = 0; i < 3; i++)
+	{
+		result.axes[i] = rotation.rows[i];
+		result.extents[i] = (bounds.maxs[i] - bounds.mins[i]) * 0.5f;
+	}
+	return result;
+}
+
+float ProjectedRadius(const orientedBox_t& box, const Vec3& axis)
+{
+	return box.extents[0] * fabsf(box.axes[0].Dot(axis)) + box.extents[1] * fabsf(box.axes[1].Dot(axis)) + box.extents[2] * fabsf(box.axes[2].Dot(axis));
+}
+
+/*
+====================================================
+TestAxis
+
+Returns false if the boxes are separated along the axis, otherwise keeps the axis in best if it has the largest
+separation so far
+====================================================
+*/
+bool TestAxis(const orientedBox_t& boxA, const orientedBox_t& boxB, const Vec3& axis, const axisType_t type, const int axisA, const int axisB, boxAxis_t& best)
+{
+	const Vec3 delta = boxB.center - boxA.center;
+	const float distance = delta.Dot(axis);
+	const float separation = fabsf(distance) - (ProjectedRadius(boxA, axis) + ProjectedRadius(boxB, axis));
+	if (separation > 0.0f)
+	{
+		return false;
+	}
+
+	if (separation > best.separation)
+	{
+		best.separation = separation;
+		best.normal = (distance < 0.0f) ? axis * -1.0f : axis;
+		best.type = type;
+		best.axisA = axisA;
+		best.axisB = axisB;
+	}
+	return true;
+}
+
+/*
+====================================================
+FaceContacts
+
+Clips the incident face of the incident box against the reference face, normal points from the reference box
+towards the incident box. Writes the points on the reference face and the matching points of the incident box.
+====================================================
+*/
+int FaceContacts(const orientedBox_t& reference, const orientedBox_t& incident, const int referenceAxis, const Vec3& normal, Vec3* ptsOnReference, Vec3* ptsOnIncident, float* separations)
+{
+	// The incident face is the one whose normal is most anti-parallel to the reference normal
+	int incidentAxis = 0;
+	float maxDot = -1.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		const float dot = fabsf(incident.axes[i].Dot(normal));
+		if (dot > maxDot)
+		{
+			maxDot = dot;
+			incidentAxis = i;
+		}
+	}
+	const float incidentSign = (incident.axes[incidentAxis].Dot(normal) > 0.0f) ? -1.0f : 1.0f;
+	const Vec3 incidentCenter = incident.center + incident.axes[incidentAxis] * (incidentSign * incident.extents[incidentAxis]);
+
+	const int u = (incidentAxis + 1) % 3;
+	const int v = (incidentAxis + 2) % 3;
+	const Vec3 du = incident.axes[u] * incident.extents[u];
+	const Vec3 dv = incident.axes[v] * incident.extents[v];
+
+	Vec3 polygon[MAX_BOX_CLIP_POINTS];
+	Vec3 clipped[MAX_BOX_CLIP_POINTS];
+	polygon[0] = incidentCenter + du + dv;
+	polygon[1] = incidentCenter - du + dv;
+	polygon[2] = incidentCenter - du - dv;
+	polygon[3] = incidentCenter + du - dv;
+	int num = 4;
+
+	// Clip against the side planes of the reference face
+	for (int side = 1; side < 3 && num > 0; side++)
+	{
+		const int axis = (referenceAxis + side) % 3;
+		const Vec3& sideNormal = reference.axes[axis];
+		const float centerDist = sideNormal.Dot(reference.center);
+
+		num = ClipPolygon(polygon, num, sideNormal, centerDist + reference.extents[axis], clipped);
+		num = ClipPolygon(clipped, num, sideNormal * -1.0f, -centerDist + reference.extents[axis], polygon);
+	}
+
+	// Only the points below the reference face are in contact
+	const Vec3 referenceCenter = reference.center + normal * reference.extents[referenceAxis];
+	const float faceOffset = normal.Dot(referenceCenter);
+
+	Vec3 points[MAX_BOX_CLIP_POINTS];
+	float depths[MAX_BOX_CLIP_POINTS];
+	int numPoints = 0;
+	for (int i = 0; i < num; i++)
+	{
+		const float separation = normal.Dot(polygon[i]) - faceOffset;
+		if (separation <= 0.0f)
+		{
+			points[numPoints] = polygon[i];
+			depths[numPoints] = -separation;
+			numPoints++;
+		}
+	}
+
+	int kept[MAX_REDUCED_CONTACTS];
+	const int numKept = ReduceContacts(points, depths, numPoints, normal, kept);
+	for (int i = 0; i < numKept; i++)
+	{
+		const Vec3& pt = points[kept[i]];
+		ptsOnIncident[i] = pt;
+		ptsOnReference[i] = pt + normal * depths[kept[i]];
+		separations[i] = -depths[kept[i]];
+	}
+	return numKept;
+}
+
+/*
+====================================================
+EdgeContact
+====================================================
+*/
+void EdgeContact(const orientedBox_t& boxA, const orientedBox_t& boxB, const int axisA, const int axisB, const Vec3& normal, Vec3& ptOnA, Vec3& ptOnB)
+{
+	// Find the edges of both boxes that support the axis
+	Vec3 edgeA = boxA.center;
+	Vec3 edgeB = boxB.center;
+	for (int i = 0; i < 3; i++)
+	{
+		if (i != axisA)
+		{
+			const float sign = (boxA.axes[i].Dot(normal) > 0.0f) ? 1.0f : -1.0f;
+			edgeA += boxA.axes[i] * (sign * boxA.extents[i]);
+		}
+		if (i != axisB)
+		{
+			const float sign = (boxB.axes[i].Dot(normal) > 0.0f) ? -1.0f : 1.0f;
+			edgeB += boxB.axes[i] * (sign * boxB.extents[i]);
+		}
+	}
+
+	// Closest points between the two edge lines, clamped to the edges
+	const Vec3& dirA = boxA.axes[axisA];
+	const Vec3& dirB = boxB.axes[axisB];
+	const Vec3 r = edgeA - edgeB;
+	const float b = dirA.Dot(dirB);
+	const float c = dirA.Dot(r);
+	const float f = dirB.Dot(r);
+	const float denom = 1.0f - b * b;
+
+	float s = (denom > 1e-6f) ? (b * f - c) / denom : 0.0f;
+	s = std::max(-boxA.extents[axisA], std::min(boxA.extents[axisA], s));
+	float t = b * s + f;
+	t = std::max(-boxB.extents[axisB], std::min(boxB.extents[axisB], t));
+	s = t * b - c;
+	s = std::max(-boxA.extents[axisA], std::min(boxA.extents[axisA], s));
+
+	ptOnA = edgeA + dirA * s;
+	ptOnB = edgeB + dirB * t;
+}
+
+/*
+====================================================
+BoxBoxContacts
+====================================================
+*/
+int BoxBoxContacts(Body* bodyA, Body* bodyB, contact_t* contacts)
+{
+	const orientedBox_t boxA = GetOrientedBox(bodyA);
+	const orientedBox_t boxB = GetOrientedBox(bodyB);
+
+	boxAxis_t faceA;
+	faceA.separation = -FLT_MAX;
+	for (int i = 0; i < 3; i++)
+	{
+		if (!TestAxis(boxA, boxB, boxA.axes[i], AXIS_FACE_A, i, -1, faceA))
+		{
+			return 0;
+		}
+	}
+
+	boxAxis_t faceB;
+	faceB.separation = -FLT_MAX;
+	for (int j = 0; j < 3; j++)
+	{
+		if (!TestAxis(boxA, boxB, boxB.axes[j], AXIS_FACE_B, -1, j, faceB))
+		{
+			return 0;
+		}
+	}
+
+	boxAxis_t edge;
+	edge.separation = -FLT_MAX;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			Vec3 axis = boxA.axes[i].Cross(boxB.axes[j]);
+			const float lengthSqr = axis.GetLengthSqr();
+			if (lengthSqr < 1e-6f)
+			{
+				// Parallel edges, the face axes already cover this direction
+				continue;
+			}
+			axis /= sqrtf(lengthSqr);
+
+			if (!TestAxis(boxA, boxB, axis, AXIS_EDGES, i, j, edge))
+			{
+				return 0;
+			}
+		}
+	}
+
+	// Prefer face contacts, an edge axis or a face of B has to be clearly better to be picked. This keeps the
+	// manifold from flipping between features on resting boxes.
+	float size = FLT_MAX;
+	for (int i = 0; i < 3; i++)
+	{
+		size = std::min(size, std::min(boxA.extents[i], boxB.extents[i]));
+	}
+
+	boxAxis_t best = faceA;
+	if (IsFeatureClearlyBetter(faceB.separation, best.separation, size))
+	{
+		best = faceB;
+	}
+	if (IsFeatureClearlyBetter(edge.separation, best.separation, size))
+	{
+		best = edge;
+	}
+
+	Vec3 ptsOnA[MAX_BOX_CONTACTS];
+	Vec3 ptsOnB[MAX_BOX_CONTACTS];
+	float separations[MAX_BOX_CONTACTS];
+	int numContacts = 0;
+	if (best.type == AXIS_FACE_A)
+	{
+		numContacts = FaceContacts(boxA, boxB, best.axisA, best.normal, ptsOnA, ptsOnB, separations);
+	}
+	else if (best.type == AXIS_FACE_B)
+	{
+		numContacts = FaceContacts(boxB, boxA, best.axisB, best.normal * -1.0f, ptsOnB, ptsOnA, separations);
+	}
+	else
+	{
+		EdgeContact(boxA, boxB, best.axisA, best.axisB, best.normal, ptsOnA[0], ptsOnB[0]);
+		separations[0] = best.separation;
+		numContacts = 1;
+	}
+
+	for (int i = 0; i < numContacts; i++)
+	{
+		contact_t& contact = contacts[i];
+		contact.bodyA = bodyA;
+		contact.bodyB = bodyB;
+		contact.normal = best.normal;
+		contact.ptOnA_WorldSpace = ptsOnA[i];
+		contact.ptOnB_WorldSpace = ptsOnB[i];
+		contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(ptsOnA[i]);
+		contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(ptsOnB[i]);
+		contact.separationDistance = separations[i];
+		contact.timeOfImpact = 0.0f;
+	}
+	return numContacts;
+}
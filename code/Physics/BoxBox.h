@@ -0,0 +1,20 @@
+//
+//	BoxBox.h
+//
+#pragma once
+#include "Contact.h"
+#include "ContactClipping.h"
+
+static const int MAX_BOX_CONTACTS = MAX_REDUCED_CONTACTS;
+
+/*
+====================================================
+BoxBoxContacts
+
+Separating axis test between two oriented boxes over the 6 face normals and the 9 edge cross products. When the
+boxes overlap along every axis, the face of least penetration is taken as the reference face and the most
+anti-parallel face of the other box is clipped against it, which gives up to 4 contacts in one call. An edge pair
+gives a single contact. Returns the number of contacts written, 0 when the boxes are separated.
+====================================================
+*/
+int BoxBoxContacts(Body* bodyA, Body* bodyB, contact_t* contacts);
@@ -2,13 +2,10 @@
 //  Broadphase.cpp
 //
 #include "Broadphase.h"
-
-struct pseudoBody_t
-{
-	int id;
-	float value;
-	bool isMin;
-};
+#include "ThreadPool.h"
+#include <xmmintrin.h>
+#include <stdint.h>
+#include <string.h>
 
 int CompareSAP(const void* a, const void* b)
 {
@@ -17,77 +14,519 @@ int CompareSAP(const void* a, const void* b)
 	return bodyA->value < bodyB->value ? -1 : 1;
 }
 
-void SortBodiesBounds(const Body* bodies, const int num, pseudoBody_t* sortedArray, const float dt_sec)
+/*
+====================================================
+SweptBounds
+====================================================
+*/
+Bounds SweptBounds(const Body& body, const float dt_sec)
+{
+	return SweptBounds(body, body.m_shape->GetBounds(body.m_position, body.m_orientation), dt_sec);
+}
+
+/*
+====================================================
+SweptBounds
+====================================================
+*/
+Bounds SweptBounds(const Body& body, const Bounds& worldBounds, const float dt_sec)
+{
+	Bounds bounds = worldBounds;
+
+	// Expand the bounds by the velocity
+	bounds.Expand(bounds.mins + body.m_linearVelocity * dt_sec);
+	bounds.Expand(bounds.maxs + body.m_linearVelocity * dt_sec);
+
+	const float epsilon = 0.01f;
+	bounds.Expand(bounds.mins + Vec3(-1, -1, -1) * epsilon);
+	bounds.Expand(bounds.maxs + Vec3(1, 1, 1) * epsilon);
+	return bounds;
+}
+
+void ProjectBodiesBounds(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, boundsArray_t& boundsArray, float* projectedMins, float* projectedMaxs, const float dt_sec)
 {
 	Vec3 axis = Vec3(1, 1, 1);
 	axis.Normalize();
 
 	for (int i = 0; i < num; i++)
 	{
-		const Body& body = bodies[i];
-		Bounds bounds = body.m_shape->GetBounds(body.m_position, body.m_orientation);
+		const int bodyId = bodyIds[i];
+		const Bounds bounds = SweptBounds(bodies[bodyId], worldBounds.Get(bodyId), dt_sec);
+
+		boundsArray.Set(i, bounds);
+		projectedMins[i] = axis.Dot(bounds.mins);
+		projectedMaxs[i] = axis.Dot(bounds.maxs);
+	}
+}
+
+uint32_t SortableKey(const float value)
+{
+	// Flipping the sign bit of positive floats and all the bits of negative ones makes the unsigned integer order
+	// match the float order
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+/*
+====================================================
+RadixSortEndpoints
+
+LSD radix sort with 8 bit digits. The histograms and the scatter of every pass are split across the thread
+pool, every chunk scatters into its own slice of each bucket, so the sort stays stable.
+====================================================
+*/
+void RadixSortEndpoints(pseudoBody_t* endpoints, const int num, std::vector<pseudoBody_t>& scratch)
+{
+	if (num <= 1)
+	{
+		return;
+	}
 
-		// Expand the bounds by the velocity
-		bounds.Expand(bounds.mins + body.m_linearVelocity * dt_sec);
-		bounds.Expand(bounds.maxs + body.m_linearVelocity * dt_sec);
+	const int minItemsPerChunk = 16 * 1024;
+	const int numChunks = ThreadPool::Get().GetNumChunks(num, minItemsPerChunk);
 
-		const float epsilon = 0.01f;
-		bounds.Expand(bounds.mins + Vec3(-1, -1, -1) * epsilon);
-		bounds.Expand(bounds.maxs + Vec3(1, 1, 1) * epsilon);
+	scratch.resize(num);
+	pseudoBody_t* src = endpoints;
+	pseudoBody_t* dst = scratch.data();
 
+	std::vector<uint32_t> histograms(numChunks * 256);
+	std::vector<uint32_t> offsets(numChunks * 256);
+
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		std::fill(histograms.begin(), histograms.end(), 0);
+		ParallelFor(num, minItemsPerChunk, [&](const int begin, const int end, const int chunk)
+		{
+			uint32_t* histogram = &histograms[chunk * 256];
+			for (int i = begin; i < end; i++)
+			{
+				histogram[(SortableKey(src[i].value) >> shift) & 0xFF]++;
+			}
+		});
+
+		// Every chunk starts writing a digit after the same digit of all the previous chunks
+		uint32_t offset = 0;
+		bool isPassNeeded = true;
+		for (int digit = 0; digit < 256; digit++)
+		{
+			for (int chunk = 0; chunk < numChunks; chunk++)
+			{
+				const uint32_t count = histograms[chunk * 256 + digit];
+				offsets[chunk * 256 + digit] = offset;
+				offset += count;
+			}
+
+			// All the keys share this digit, the pass would not change anything
+			if (offset == (uint32_t)num && offsets[digit] == 0)
+			{
+				isPassNeeded = false;
+				break;
+			}
+		}
+		if (!isPassNeeded)
+		{
+			continue;
+		}
+
+		ParallelFor(num, minItemsPerChunk, [&](const int begin, const int end, const int chunk)
+		{
+			uint32_t* offset = &offsets[chunk * 256];
+			for (int i = begin; i < end; i++)
+			{
+				dst[offset[(SortableKey(src[i].value) >> shift) & 0xFF]++] = src[i];
+			}
+		});
+		std::swap(src, dst);
+	}
+
+	if (src != endpoints)
+	{
+		memcpy(endpoints, src, num * sizeof(pseudoBody_t));
+	}
+}
+
+void SortEndpoints(pseudoBody_t* endpoints, const int num, std::vector<pseudoBody_t>& scratch)
+{
+	if (num / 2 > SweepAndPrune::RADIX_SORT_THRESHOLD)
+	{
+		RadixSortEndpoints(endpoints, num, scratch);
+	}
+	else
+	{
+		std::qsort(endpoints, num, sizeof(pseudoBody_t), CompareSAP);
+	}
+}
+
+void SortBodiesBounds(const float* projectedMins, const float* projectedMaxs, const int num, pseudoBody_t* sortedArray, std::vector<pseudoBody_t>& scratch)
+{
+	for (int i = 0; i < num; i++)
+	{
 		const int array_idx = 2 * i;
 		sortedArray[array_idx].id = i;
-		sortedArray[array_idx].value = axis.Dot(bounds.mins);
+		sortedArray[array_idx].value = projectedMins[i];
 		sortedArray[array_idx].isMin = true;
 
 		sortedArray[array_idx + 1].id = i;
-		sortedArray[array_idx + 1].value = axis.Dot(bounds.maxs);
+		sortedArray[array_idx + 1].value = projectedMaxs[i];
 		sortedArray[array_idx + 1].isMin = false;
 	}
 
-	std::qsort(sortedArray, 2 * num, sizeof(pseudoBody_t), CompareSAP);
+	SortEndpoints(sortedArray, 2 * num, scratch);
 }
 
-void BuildPairs(std::vector<collisionPair_t>& collisionPairs, const pseudoBody_t* sortedBodies, const int num)
+/*
+====================================================
+SweepAndPrune::Update
+====================================================
+*/
+void SweepAndPrune::Update(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec)
 {
-	collisionPairs.clear();
+	// The endpoints reference bodies by their index in bodyIds, so any change in the body count invalidates the list
+	if (m_endpoints.size() != 2 * num)
+	{
+		Rebuild(bodies, worldBounds, bodyIds, num, dt_sec);
+		return;
+	}
+
+	ProjectBodiesBounds(bodies, worldBounds, bodyIds, num, m_bounds, m_projectedMins.data(), m_projectedMaxs.data(), dt_sec);
+	for (pseudoBody_t& endpoint : m_endpoints)
+	{
+		endpoint.value = endpoint.isMin ? m_projectedMins[endpoint.id] : m_projectedMaxs[endpoint.id];
+	}
 
-	for (int i = 0; i < 2 * num; i++)
+	// When the bodies moved too much for the insertion sort to pay off, sort from scratch
+	const int maxShifts = 8 * (int)m_endpoints.size();
+	if (!InsertionSort(maxShifts))
 	{
-		const pseudoBody_t& a = sortedBodies[i];
-		if (!a.isMin)
+		SortEndpoints(m_endpoints.data(), (int)m_endpoints.size(), m_sortScratch);
+	}
+}
+
+/*
+====================================================
+SweepAndPrune::Rebuild
+====================================================
+*/
+void SweepAndPrune::Rebuild(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec)
+{
+	m_endpoints.resize(2 * num);
+	m_projectedMins.resize(num);
+	m_projectedMaxs.resize(num);
+	m_bounds.Resize(num);
+
+	ProjectBodiesBounds(bodies, worldBounds, bodyIds, num, m_bounds, m_projectedMins.data(), m_projectedMaxs.data(), dt_sec);
+	SortBodiesBounds(m_projectedMins.data(), m_projectedMaxs.data(), num, m_endpoints.data(), m_sortScratch);
+}
+
+/*
+====================================================
+SweepAndPrune::InsertionSort
+====================================================
+*/
+bool SweepAndPrune::InsertionSort(const int maxShifts)
+{
+	// Near linear for coherent scenes since every endpoint only moves past the few neighbours it overtook this frame
+	int numShifts = 0;
+	for (int i = 1; i < m_endpoints.size(); i++)
+	{
+		const pseudoBody_t endpoint = m_endpoints[i];
+
+		int j = i - 1;
+		while (j >= 0 && m_endpoints[j].value > endpoint.value)
 		{
-			continue;
+			m_endpoints[j + 1] = m_endpoints[j];
+			j--;
+		}
+		m_endpoints[j + 1] = endpoint;
+
+		numShifts += i - 1 - j;
+		if (numShifts > maxShifts)
+		{
+			return false;
 		}
+	}
+	return true;
+}
+
+/*
+====================================================
+MergePairBuffers
+====================================================
+*/
+void MergePairBuffers(const std::vector<pairBuffer_t>& buffers, const int numChunks, std::vector<collisionPair_t>& collisionPairs)
+{
+	size_t numPairs = collisionPairs.size();
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		numPairs += buffers[chunk].pairs.size();
+	}
+	collisionPairs.reserve(numPairs);
 
-		collisionPair_t pair;
-		pair.a = a.id;
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		collisionPairs.insert(collisionPairs.end(), buffers[chunk].pairs.begin(), buffers[chunk].pairs.end());
+	}
+}
 
-		for (int j = i + 1; j < 2 * num; j++)
+/*
+====================================================
+SweepAndPrune::BuildPairs
+====================================================
+*/
+void SweepAndPrune::BuildPairs(std::vector<collisionPair_t>& collisionPairs)
+{
+	collisionPairs.clear();
+	m_numRejectedPairs = 0;
+
+	const int numEndpoints = (int)m_endpoints.size();
+	const int numChunks = ThreadPool::Get().GetNumChunks(numEndpoints, MIN_ENDPOINTS_PER_CHUNK);
+	if (m_pairBuffers.size() < numChunks)
+	{
+		m_pairBuffers.resize(numChunks);
+	}
+
+	// Every chunk opens the bodies whose min endpoint is in its range, the scan for their candidates may run past
+	// the end of the range since the endpoints are only read
+	ParallelFor(numEndpoints, MIN_ENDPOINTS_PER_CHUNK, [&](const int begin, const int end, const int chunk)
+	{
+		pairBuffer_t& buffer = m_pairBuffers[chunk];
+		buffer.pairs.clear();
+		buffer.numRejected = 0;
+
+		for (int i = begin; i < end; i++)
 		{
-			const pseudoBody_t& b = sortedBodies[j];
-			// If we hit the end of the a element, we are done creating pairs for it
-			if (b.id == a.id)
+			const pseudoBody_t& a = m_endpoints[i];
+			if (!a.isMin)
 			{
-				break;
+				continue;
 			}
 
-			if (!b.isMin)
+			// Gather all the bodies that start while a is still open
+			buffer.scratch.clear();
+			for (int j = i + 1; j < numEndpoints; j++)
 			{
+				const pseudoBody_t& b = m_endpoints[j];
+				// If we hit the end of the a element, we are done creating pairs for it
+				if (b.id == a.id)
+				{
+					break;
+				}
+
+				if (!b.isMin)
+				{
+					continue;
+				}
+
+				buffer.scratch.push_back(b.id);
+			}
+
+			FilterCandidates(a.id, buffer);
+		}
+	});
+
+	MergePairBuffers(m_pairBuffers, numChunks, collisionPairs);
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		m_numRejectedPairs += m_pairBuffers[chunk].numRejected;
+	}
+}
+
+/*
+====================================================
+SweepAndPrune::FilterCandidates
+
+Tests the full 3D bounds of the candidates in the buffer's scratch against the body, four candidates at a time
+====================================================
+*/
+void SweepAndPrune::FilterCandidates(const int bodyId, pairBuffer_t& buffer) const
+{
+	const boundsArray_t& bounds = m_bounds;
+	const int* candidates = buffer.scratch.data();
+	const int numCandidates = (int)buffer.scratch.size();
+	std::vector<collisionPair_t>& collisionPairs = buffer.pairs;
+
+	collisionPair_t pair;
+	pair.a = bodyId;
+
+	const __m128 aMinX = _mm_set1_ps(bounds.minX[bodyId]);
+	const __m128 aMinY = _mm_set1_ps(bounds.minY[bodyId]);
+	const __m128 aMinZ = _mm_set1_ps(bounds.minZ[bodyId]);
+	const __m128 aMaxX = _mm_set1_ps(bounds.maxX[bodyId]);
+	const __m128 aMaxY = _mm_set1_ps(bounds.maxY[bodyId]);
+	const __m128 aMaxZ = _mm_set1_ps(bounds.maxZ[bodyId]);
+
+	int k = 0;
+	for (; k + 4 <= numCandidates; k += 4)
+	{
+		const int* ids = candidates + k;
+		const __m128 bMinX = _mm_set_ps(bounds.minX[ids[3]], bounds.minX[ids[2]], bounds.minX[ids[1]], bounds.minX[ids[0]]);
+		const __m128 bMinY = _mm_set_ps(bounds.minY[ids[3]], bounds.minY[ids[2]], bounds.minY[ids[1]], bounds.minY[ids[0]]);
+		const __m128 bMinZ = _mm_set_ps(bounds.minZ[ids[3]], bounds.minZ[ids[2]], bounds.minZ[ids[1]], bounds.minZ[ids[0]]);
+		const __m128 bMaxX = _mm_set_ps(bounds.maxX[ids[3]], bounds.maxX[ids[2]], bounds.maxX[ids[1]], bounds.maxX[ids[0]]);
+		const __m128 bMaxY = _mm_set_ps(bounds.maxY[ids[3]], bounds.maxY[ids[2]], bounds.maxY[ids[1]], bounds.maxY[ids[0]]);
+		const __m128 bMaxZ = _mm_set_ps(bounds.maxZ[ids[3]], bounds.maxZ[ids[2]], bounds.maxZ[ids[1]], bounds.maxZ[ids[0]]);
+
+		// Same test as Bounds::DoesIntersect, the boxes overlap unless one ends before the other starts
+		__m128 overlap = _mm_and_ps(_mm_cmple_ps(bMinX, aMaxX), _mm_cmple_ps(aMinX, bMaxX));
+		overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(bMinY, aMaxY), _mm_cmple_ps(aMinY, bMaxY)));
+		overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(bMinZ, aMaxZ), _mm_cmple_ps(aMinZ, bMaxZ)));
+
+		const int mask = _mm_movemask_ps(overlap);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			if ((mask & (1 << lane)) == 0)
+			{
+				buffer.numRejected++;
 				continue;
 			}
 
-			pair.b = b.id;
+			pair.b = ids[lane];
 			collisionPairs.push_back(pair);
 		}
 	}
+
+	for (; k < numCandidates; k++)
+	{
+		const int b = candidates[k];
+		if (bounds.maxX[bodyId] < bounds.minX[b] || bounds.maxY[bodyId] < bounds.minY[b] || bounds.maxZ[bodyId] < bounds.minZ[b] ||
+			bounds.maxX[b] < bounds.minX[bodyId] || bounds.maxY[b] < bounds.minY[bodyId] || bounds.maxZ[b] < bounds.minZ[bodyId])
+		{
+			buffer.numRejected++;
+			continue;
+		}
+
+		pair.b = b;
+		collisionPairs.push_back(pair);
+	}
+}
+
+/*
+====================================================
+BroadPhaseContext::Clear
+====================================================
+*/
+void BroadPhaseContext::Clear()
+{
+	m_sweepAndPrune.Clear();
+	m_tree.Clear();
+	m_grid.Clear();
+	m_pairCache.Clear();
+
+	m_dynamicIds.clear();
+	m_staticIds.clear();
+	m_staticTree.Clear();
+	m_staticBounds.clear();
+	m_staticPositions.clear();
+	m_staticOrientations.clear();
+	m_builtStaticIds.clear();
+	m_numBodies = 0;
+}
+
+/*
+====================================================
+BroadPhaseContext::HaveStaticsChanged
+====================================================
+*/
+bool BroadPhaseContext::HaveStaticsChanged(const Body* bodies) const
+{
+	if (m_staticIds != m_builtStaticIds)
+	{
+		return true;
+	}
+
+	for (int i = 0; i < m_staticIds.size(); i++)
+	{
+		const Body& body = bodies[m_staticIds[i]];
+		if (body.m_position != m_staticPositions[i] || body.m_orientation.ToVec4() != m_staticOrientations[i])
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
-void SweepAndPrune1D(const Body* bodies, const int num, std::vector<collisionPair_t>& finalPairs, const float dt_sec)
+/*
+====================================================
+BroadPhaseContext::UpdateStatics
+====================================================
+*/
+void BroadPhaseContext::UpdateStatics(const Body* bodies, const int num, const float dt_sec)
 {
-	pseudoBody_t* sortedBodies = (pseudoBody_t*)_malloca(2 * num * sizeof(pseudoBody_t));
-	SortBodiesBounds(bodies, num, sortedBodies, dt_sec);
-	BuildPairs(finalPairs, sortedBodies, num);
+	m_dynamicIds.clear();
+	m_staticIds.clear();
+	for (int i = 0; i < num; i++)
+	{
+		if (bodies[i].m_invMass == 0.0f)
+		{
+			m_staticIds.push_back(i);
+		}
+		else
+		{
+			m_dynamicIds.push_back(i);
+		}
+	}
+
+	// Adding bodies shifts the meaning of the per method data, even when the statics stay the same
+	if (num != m_numBodies)
+	{
+		m_sweepAndPrune.Clear();
+		m_tree.Clear();
+		m_numBodies = num;
+	}
+
+	if (!HaveStaticsChanged(bodies))
+	{
+		return;
+	}
+
+	const int numStatics = (int)m_staticIds.size();
+	m_staticTree.Clear();
+	m_staticBounds.resize(numStatics);
+	m_staticPositions.resize(numStatics);
+	m_staticOrientations.resize(numStatics);
+	for (int i = 0; i < numStatics; i++)
+	{
+		// Statics can be placed without going through Body::Update, so their bounds come from the shape
+		const Body& body = bodies[m_staticIds[i]];
+		m_staticBounds[i] = SweptBounds(body, dt_sec);
+		m_staticPositions[i] = body.m_position;
+		m_staticOrientations[i] = body.m_orientation.ToVec4();
+		m_staticTree.Insert(m_staticBounds[i], i);
+	}
+	m_builtStaticIds = m_staticIds;
+	m_numStaticRebuilds++;
+}
+
+/*
+====================================================
+BroadPhaseContext::FindStaticPairs
+====================================================
+*/
+void BroadPhaseContext::FindStaticPairs(const Body* bodies, const boundsArray_t& worldBounds, const float dt_sec, std::vector<collisionPair_t>& collisionPairs)
+{
+	for (const int dynamicId : m_dynamicIds)
+	{
+		const Bounds bounds = SweptBounds(bodies[dynamicId], worldBounds.Get(dynamicId), dt_sec);
+
+		m_staticOverlaps.clear();
+		m_staticTree.Query(bounds, m_staticOverlaps);
+		std::sort(m_staticOverlaps.begin(), m_staticOverlaps.end());
+
+		for (const int staticIdx : m_staticOverlaps)
+		{
+			// The tree stores fattened bounds, so do the exact test before emitting the pair
+			if (!bounds.DoesIntersect(m_staticBounds[staticIdx]))
+			{
+				continue;
+			}
+
+			collisionPair_t pair;
+			pair.a = dynamicId;
+			pair.b = m_staticIds[staticIdx];
+			collisionPairs.push_back(pair);
+		}
+	}
 }
 
 /*
@@ -95,8 +534,38 @@ void SweepAndPrune1D(const Body* bodies, const int num, std::vector<collisionPai
 BroadPhase
 ====================================================
 */
-void BroadPhase(const Body* bodies, const int num, std::vector< collisionPair_t >& finalPairs, const float dt_sec)
+void BroadPhase(BroadPhaseContext& context, const Body* bodies, const boundsArray_t& worldBounds, const int num, std::vector< collisionPair_t >& finalPairs, const float dt_sec)
 {
 	finalPairs.clear();
-	SweepAndPrune1D(bodies, num, finalPairs, dt_sec);
-}
\ No newline at end of file
+	context.UpdateStatics(bodies, num, dt_sec);
+
+	// Dynamic vs dynamic pairs, the methods work on indices into the dynamic body list
+	const int* dynamicIds = context.m_dynamicIds.data();
+	const int numDynamic = (int)context.m_dynamicIds.size();
+	switch (context.m_method)
+	{
+	case BroadPhaseContext::METHOD_SWEEP_AND_PRUNE:
+		context.m_sweepAndPrune.Update(bodies, worldBounds, dynamicIds, numDynamic, dt_sec);
+		context.m_sweepAndPrune.BuildPairs(finalPairs);
+		break;
+	case BroadPhaseContext::METHOD_DYNAMIC_TREE:
+		context.m_tree.Update(bodies, worldBounds, dynamicIds, numDynamic, dt_sec);
+		context.m_tree.BuildPairs(finalPairs);
+		break;
+	case BroadPhaseContext::METHOD_SPATIAL_HASH_GRID:
+		context.m_grid.Update(bodies, worldBounds, dynamicIds, numDynamic, dt_sec);
+		context.m_grid.BuildPairs(finalPairs);
+		break;
+	}
+
+	for (collisionPair_t& pair : finalPairs)
+	{
+		pair.a = dynamicIds[pair.a];
+		pair.b = dynamicIds[pair.b];
+	}
+
+	// Dynamic vs static pairs
+	context.FindStaticPairs(bodies, worldBounds, dt_sec, finalPairs);
+
+	context.m_pairCache.Update(finalPairs);
+}
@@ -3,20 +3,125 @@
 //
 #pragma once
 #include "Body.h"
+#include "CollisionPair.h"
+#include "DynamicAabbTree.h"
+#include "PairCache.h"
+#include "SpatialHashGrid.h"
 #include <vector>
 
+struct pseudoBody_t
+{
+	int id;
+	float value;
+	bool isMin;
+};
+
+// Bounds of the body expanded by its motion during the step
+Bounds SweptBounds(const Body& body, const float dt_sec);
+// Same as above, starting from the cached world space bounds of the body instead of asking the shape for them
+Bounds SweptBounds(const Body& body, const Bounds& worldBounds, const float dt_sec);
+
+/*
+====================================================
+SweepAndPrune
+====================================================
+*/
+class SweepAndPrune
+{
+public:
+	SweepAndPrune() : m_numRejectedPairs(0) {}
+
+	void Clear() { m_endpoints.clear(); }
+
+	// Refreshes the endpoint values and restores the sorted order. Since the order of the endpoints barely changes
+	// between frames, the persistent list is fixed up with an insertion sort instead of being sorted from scratch.
+	void Update(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec);
+	// Only pairs whose full 3D bounds overlap are emitted, the overlap along the sweep axis alone is not enough.
+	// The sweep is split into ranges of endpoints across the thread pool.
+	void BuildPairs(std::vector<collisionPair_t>& collisionPairs);
+
+	// Number of pairs that overlapped along the sweep axis but were rejected by the 3D test in the last BuildPairs
+	int GetNumRejectedPairs() const { return m_numRejectedPairs; }
+
+	// Above this many bodies full sorts use a radix sort instead of qsort
+	static const int RADIX_SORT_THRESHOLD = 2048;
+	// Smallest range of endpoints that is worth handing to another thread
+	static const int MIN_ENDPOINTS_PER_CHUNK = 512;
+
+private:
+	void Rebuild(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec);
+	// Gives up and returns false once the endpoints have been shifted more than maxShifts times
+	bool InsertionSort(const int maxShifts);
+	void FilterCandidates(const int bodyId, pairBuffer_t& buffer) const;
+
+	std::vector<pseudoBody_t> m_endpoints;
+	std::vector<float> m_projectedMins;
+	std::vector<float> m_projectedMaxs;
+	boundsArray_t m_bounds;
+	std::vector<pseudoBody_t> m_sortScratch;
+
+	std::vector<pairBuffer_t> m_pairBuffers;
+	int m_numRejectedPairs;
+};
 
-struct collisionPair_t
+/*
+====================================================
+BroadPhaseContext
+
+Persistent broadphase data owned by the scene. The method can be switched at runtime, so the strategies
+can be compared on the same scene.
+
+Only the dynamic bodies go through the selected method. Static bodies live in a separate tree that is only
+rebuilt when the statics change, and the dynamic bodies are queried against it, so static-static pairs are
+never generated.
+
+The final pairs of every step are also fed to the pair cache, which tells which pairs are new, which persist
+from the previous step and which ended.
+====================================================
+*/
+class BroadPhaseContext
 {
-	int a;
-	int b;
-
-	bool operator == (const collisionPair_t& rhs) const {
-		return (((a == rhs.a) && (b == rhs.b)) || ((a == rhs.b) && (b == rhs.a)));
-	}
-	bool operator != (const collisionPair_t& rhs) const {
-		return !(*this == rhs);
-	}
+public:
+	enum method_t {
+		METHOD_SWEEP_AND_PRUNE,
+		METHOD_DYNAMIC_TREE,
+		METHOD_SPATIAL_HASH_GRID,
+	};
+
+	BroadPhaseContext() : m_method(METHOD_SWEEP_AND_PRUNE), m_numBodies(0), m_numStaticRebuilds(0) {}
+
+	void Clear();
+
+	// Splits the bodies into static and dynamic ones and rebuilds the static tree if the statics changed
+	void UpdateStatics(const Body* bodies, const int num, const float dt_sec);
+	void FindStaticPairs(const Body* bodies, const boundsArray_t& worldBounds, const float dt_sec, std::vector<collisionPair_t>& collisionPairs);
+
+	int GetNumStaticRebuilds() const { return m_numStaticRebuilds; }
+
+	method_t m_method;
+	SweepAndPrune m_sweepAndPrune;
+	DynamicAabbTree m_tree;
+	SpatialHashGrid m_grid;
+
+	// Pairs of the last BroadPhase call with ids that persist across steps
+	PairCache m_pairCache;
+
+	std::vector<int> m_dynamicIds;
+	std::vector<int> m_staticIds;
+
+private:
+	bool HaveStaticsChanged(const Body* bodies) const;
+
+	DynamicAabbTree m_staticTree;	// Leaves reference the statics by their index in m_staticIds
+	std::vector<Bounds> m_staticBounds;
+	std::vector<Vec3> m_staticPositions;
+	std::vector<Vec4> m_staticOrientations;
+	std::vector<int> m_builtStaticIds;
+	int m_numBodies;
+	int m_numStaticRebuilds;
+
+	std::vector<int> m_staticOverlaps;
 };
 
-void BroadPhase(const Body* bodies, const int num, std::vector< collisionPair_t >& finalPairs, const float dt_sec);
\ No newline at end of file
+// The world space bounds of the bodies are read from worldBounds, which is kept up to date as the bodies move
+void BroadPhase(BroadPhaseContext& context, const Body* bodies, const boundsArray_t& worldBounds, const int num, std::vector< collisionPair_t >& finalPairs, const float dt_sec);
@@ -0,0 +1,30 @@
+//
+//	CollisionPair.h
+//
+#pragma once
+#include <vector>
+
+struct collisionPair_t
+{
+	int a;
+	int b;
+
+	bool operator == (const collisionPair_t& rhs) const {
+		return (((a == rhs.a) && (b == rhs.b)) || ((a == rhs.b) && (b == rhs.a)));
+	}
+	bool operator != (const collisionPair_t& rhs) const {
+		return !(*this == rhs);
+	}
+};
+
+// Output of one chunk of a parallel pair search, every chunk owns one so no thread writes to shared memory
+struct pairBuffer_t
+{
+	std::vector<collisionPair_t> pairs;
+	std::vector<int> scratch;
+	std::vector<int> stack;	// Traversal stack for the tree queries
+	int numRejected;
+};
+
+// Appends the chunk buffers in chunk order, which gives the same pair order as a single threaded search
+void MergePairBuffers(const std::vector<pairBuffer_t>& buffers, const int numChunks, std::vector<collisionPair_t>& collisionPairs);
@@ -2,6 +2,7 @@
 //  Contact.cpp
 //
 #include "Contact.h"
+#include <algorithm>
 
 /*
 ====================================================
@@ -70,15 +71,162 @@ void ResolveContact(const contact_t& contact)
 
 	if (contact.timeOfImpact == 0.0f)
 	{
-		const float tA = bodyA.m_invMass / (bodyA.m_invMass + bodyB.m_invMass);
-		const float tB = bodyB.m_invMass / (bodyA.m_invMass + bodyB.m_invMass);
+		ResolvePenetration(contact);
+	}
+}
+
+/*
+====================================================
+ResolvePenetration
+====================================================
+*/
+void ResolvePenetration(const contact_t& contact)
+{
+	Body& bodyA = *contact.bodyA;
+	Body& bodyB = *contact.bodyB;
+
+	const float tA = bodyA.m_invMass / (bodyA.m_invMass + bodyB.m_invMass);
+	const float tB = bodyB.m_invMass / (bodyA.m_invMass + bodyB.m_invMass);
+
+	const Vec3 ds = contact.ptOnB_WorldSpace - contact.ptOnA_WorldSpace;
+	bodyA.m_position += ds * tA;
+	bodyB.m_position -= ds * tB;
+
+	bodyA.UpdateWorldBounds();
+	bodyB.UpdateWorldBounds();
+}
+
+/*
+====================================================
+EffectiveMass
+
+Mass the pair shows to an impulse along dir at the contact points, the same as the denominator of ResolveContact
+====================================================
+*/
+static float EffectiveMass(const Body& bodyA, const Body& bodyB, const Vec3& ra, const Vec3& rb, const Vec3& dir)
+{
+	const Vec3 angularJA = (bodyA.GetInverseInertiaTensorWorldSpace() * ra.Cross(dir)).Cross(ra);
+	const Vec3 angularJB = (bodyB.GetInverseInertiaTensorWorldSpace() * rb.Cross(dir)).Cross(rb);
+	const float angularFactor = (angularJA + angularJB).Dot(dir);
+	return 1.0f / (bodyA.m_invMass + bodyB.m_invMass + angularFactor);
+}
+
+/*
+====================================================
+RelativeVelocity
+
+Velocity of the contact point on A relative to the one on B
+====================================================
+*/
+static Vec3 RelativeVelocity(const speculativeContact_t& solverContact)
+{
+	const Body& bodyA = *solverContact.contact.bodyA;
+	const Body& bodyB = *solverContact.contact.bodyB;
+
+	const Vec3 velA = bodyA.m_linearVelocity + bodyA.m_angularVelocity.Cross(solverContact.ra);
+	const Vec3 velB = bodyB.m_linearVelocity + bodyB.m_angularVelocity.Cross(solverContact.rb);
+	return velA - velB;
+}
+
+/*
+====================================================
+PrepareSpeculativeContact
 
-		const Vec3 ds = contact.ptOnB_WorldSpace - contact.ptOnA_WorldSpace;
-		bodyA.m_position += ds * tA;
-		bodyB.m_position -= ds * tB;
+The bodies may still approach as fast as closes the gap by the end of the step, so they arrive touching and the
+contact bounces from then on. Touching contacts bounce with the speed they approach at when the solve starts.
+====================================================
+*/
+void PrepareSpeculativeContact(const contact_t& contact, const float dt_sec, speculativeContact_t& solverContact)
+{
+	const Body& bodyA = *contact.bodyA;
+	const Body& bodyB = *contact.bodyB;
+	const Vec3& n = contact.normal;
+
+	solverContact.contact = contact;
+	solverContact.ra = contact.ptOnA_WorldSpace - bodyA.GetCenterOfMassWorldSpace();
+	solverContact.rb = contact.ptOnB_WorldSpace - bodyB.GetCenterOfMassWorldSpace();
+	n.GetOrtho(solverContact.tangentU, solverContact.tangentV);
+
+	solverContact.normalMass = EffectiveMass(bodyA, bodyB, solverContact.ra, solverContact.rb, n);
+	solverContact.tangentMassU = EffectiveMass(bodyA, bodyB, solverContact.ra, solverContact.rb, solverContact.tangentU);
+	solverContact.tangentMassV = EffectiveMass(bodyA, bodyB, solverContact.ra, solverContact.rb, solverContact.tangentV);
+	solverContact.friction = bodyA.m_friction * bodyB.m_friction;
+
+	solverContact.normalImpulse = 0.0f;
+	solverContact.tangentImpulseU = 0.0f;
+	solverContact.tangentImpulseV = 0.0f;
+
+	if (contact.separationDistance <= CONTACT_TOUCHING_DISTANCE)
+	{
+		const float elasticity = bodyA.m_elasticity * bodyB.m_elasticity;
+		const float approachSpeed = RelativeVelocity(solverContact).Dot(n);
+		solverContact.maxApproachSpeed = -elasticity * std::max(approachSpeed, 0.0f);
+		return;
+	}
+
+	solverContact.maxApproachSpeed = contact.separationDistance / dt_sec;
+
+	// A spinning body may bring another part of its surface closer than the closest point, so the fastest the
+	// rotation can move the surface along the normal is taken from what the bodies may close. Slow bodies are left
+	// to land, a spinning one would be held off the other body for good. Only the linear velocities are compared,
+	// the spin is what the bound is for.
+	const float linearApproachSpeed = (bodyA.m_linearVelocity - bodyB.m_linearVelocity).Dot(n);
+	if (linearApproachSpeed > solverContact.maxApproachSpeed)
+	{
+		const float rotationSpeed = bodyA.m_shape->FastestLinearSpeed(bodyA.m_angularVelocity, n) + bodyB.m_shape->FastestLinearSpeed(bodyB.m_angularVelocity, n * -1.0f);
+		solverContact.maxApproachSpeed = std::max(solverContact.maxApproachSpeed - rotationSpeed, 0.0f);
 	}
 }
 
+/*
+====================================================
+SolveSpeculativeContact
+
+One pass of sequential impulses. The normal impulse never pulls the bodies together and the friction impulse never
+exceeds what the normal impulse allows.
+====================================================
+*/
+void SolveSpeculativeContact(speculativeContact_t& solverContact)
+{
+	Body& bodyA = *solverContact.contact.bodyA;
+	Body& bodyB = *solverContact.contact.bodyB;
+	const contact_t& contact = solverContact.contact;
+	const Vec3& n = contact.normal;
+
+	const float approachSpeed = RelativeVelocity(solverContact).Dot(n);
+	const float newNormalImpulse = std::max(solverContact.normalImpulse + (approachSpeed - solverContact.maxApproachSpeed) * solverContact.normalMass, 0.0f);
+	const Vec3 normalImpulse = n * (newNormalImpulse - solverContact.normalImpulse);
+	solverContact.normalImpulse = newNormalImpulse;
+
+	bodyA.ApplyImpulse(contact.ptOnA_WorldSpace, normalImpulse * -1.0f);
+	bodyB.ApplyImpulse(contact.ptOnB_WorldSpace, normalImpulse);
+
+	// The friction of both tangents is clamped together, to a circle instead of a square
+	const Vec3 vab = RelativeVelocity(solverContact);
+	float newTangentImpulseU = solverContact.tangentImpulseU + vab.Dot(solverContact.tangentU) * solverContact.tangentMassU;
+	float newTangentImpulseV = solverContact.tangentImpulseV + vab.Dot(solverContact.tangentV) * solverContact.tangentMassV;
+	const float maxTangentImpulse = solverContact.friction * solverContact.normalImpulse;
+	const float tangentImpulseSqr = newTangentImpulseU * newTangentImpulseU + newTangentImpulseV * newTangentImpulseV;
+	if (tangentImpulseSqr > maxTangentImpulse * maxTangentImpulse)
+	{
+		const float scale = maxTangentImpulse / sqrtf(tangentImpulseSqr);
+		newTangentImpulseU *= scale;
+		newTangentImpulseV *= scale;
+	}
+
+	const Vec3 frictionImpulse = solverContact.tangentU * (newTangentImpulseU - solverContact.tangentImpulseU) + solverContact.tangentV * (newTangentImpulseV - solverContact.tangentImpulseV);
+	solverContact.tangentImpulseU = newTangentImpulseU;
+	solverContact.tangentImpulseV = newTangentImpulseV;
+
+	bodyA.ApplyImpulse(contact.ptOnA_WorldSpace, frictionImpulse * -1.0f);
+	bodyB.ApplyImpulse(contact.ptOnB_WorldSpace, frictionImpulse);
+}
+
+/*
+====================================================
+CompareContacts
+====================================================
+*/
 int CompareContacts(const void* c1, const void* c2)
 {
 	contact_t a = *(contact_t*)c1;
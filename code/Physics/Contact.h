@@ -2,8 +2,12 @@
 //	Contact.h
 //
 #pragma once
+#include <vector>
 #include "Body.h"
 
+// Contacts closer than this are touching, they bounce and get pushed apart, while farther ones only keep the bodies
+// from closing their gap too fast
+static const float CONTACT_TOUCHING_DISTANCE = 0.001f;
 
 struct contact_t {
 	Vec3 ptOnA_WorldSpace;
@@ -19,6 +23,59 @@ struct contact_t {
 	Body* bodyB = nullptr;
 };
 
+// Output of one chunk of the parallel narrowphase, every chunk owns one so no thread writes to shared memory
+struct contactBuffer_t
+{
+	std::vector<contact_t> contacts;
+};
+
+// Contact waiting in the time of impact queue. Resolving a contact changes the stamps of its bodies, so an event
+// found before that no longer matches them and is skipped.
+struct toiEvent_t
+{
+	float timeOfImpact;	// From the start of the frame
+	int contactIdx;
+	int bodyA;
+	int bodyB;
+	int stampA;
+	int stampB;
+
+	// Orders a heap with the earliest event on top, events at the same time come up in the order they were queued
+	bool operator < (const toiEvent_t& rhs) const
+	{
+		if (timeOfImpact != rhs.timeOfImpact)
+		{
+			return timeOfImpact > rhs.timeOfImpact;
+		}
+		return contactIdx > rhs.contactIdx;
+	}
+};
+
+// Speculative contact being solved over several passes. The impulses applied so far are kept, so a pass may take back
+// part of what the passes before it applied, as long as the sum still pushes the bodies apart.
+struct speculativeContact_t
+{
+	contact_t contact;
+	Vec3 ra;	// From the centers of mass to the contact points
+	Vec3 rb;
+	Vec3 tangentU;
+	Vec3 tangentV;
+	float normalMass;	// Effective masses of the pair at the contact points, angular terms included
+	float tangentMassU;
+	float tangentMassV;
+	float friction;
+	float maxApproachSpeed;	// Fastest the contact points may still approach each other along the normal
+	float normalImpulse;
+	float tangentImpulseU;
+	float tangentImpulseV;
+};
+
 void ResolveContact(const contact_t& contact);
+// Moves the bodies of a penetrating contact apart, in proportion to their inverse masses
+void ResolvePenetration(const contact_t& contact);
+
+// A contact that is apart may still close its gap within dt_sec, one that touches may not approach any further
+void PrepareSpeculativeContact(const contact_t& contact, const float dt_sec, speculativeContact_t& solverContact);
+void SolveSpeculativeContact(speculativeContact_t& solverContact);
 
 int CompareContacts(const void* c1, const void* c2);
\ No newline at end of file
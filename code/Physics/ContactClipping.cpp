@@ -0,0 +1,110 @@
+//
+//  ContactClipping.cpp
+//
+#include "ContactClipping.h"
+
+/*
+====================================================
+ClipPolygon
+
+Keeps the part of the polygon where normal.Dot(pt) <= offset
+====================================================
+*/
+int ClipPolygon(const Vec3* points, const int num, const Vec3& normal, const float offset, Vec3* clipped)
+{
+	int numClipped = 0;
+	for (int i = 0; i < num; i++)
+	{
+		const Vec3& a = points[i];
+		const Vec3& b = points[(i + 1) % num];
+		const float distA = normal.Dot(a) - offset;
+		const float distB = normal.Dot(b) - offset;
+
+		if (distA <= 0.0f)
+		{
+			clipped[numClipped++] = a;
+		}
+		if ((distA < 0.0f && distB > 0.0f) || (distA > 0.0f && distB < 0.0f))
+		{
+			const float t = distA / (distA - distB);
+			clipped[numClipped++] = a + (b - a) * t;
+		}
+	}
+	return numClipped;
+}
+
+/*
+====================================================
+ReduceContacts
+
+Keeps the deepest point, the point furthest from it and the two points that span the largest area on either side
+of the line between them
+====================================================
+*/
+int ReduceContacts(const Vec3* points, const float* depths, const int num, const Vec3& normal, int* kept)
+{
+	if (num <= MAX_REDUCED_CONTACTS)
+	{
+		for (int i = 0; i < num; i++)
+		{
+			kept[i] = i;
+		}
+		return num;
+	}
+
+	int deepest = 0;
+	for (int i = 1; i < num; i++)
+	{
+		if (depths[i] > depths[deepest])
+		{
+			deepest = i;
+		}
+	}
+
+	int furthest = (deepest == 0) ? 1 : 0;
+	for (int i = 0; i < num; i++)
+	{
+		if ((points[i] - points[deepest]).GetLengthSqr() > (points[furthest] - points[deepest]).GetLengthSqr())
+		{
+			furthest = i;
+		}
+	}
+
+	const Vec3 edge = points[furthest] - points[deepest];
+	int minArea = -1;
+	int maxArea = -1;
+	float minValue = 0.0f;
+	float maxValue = 0.0f;
+	for (int i = 0; i < num; i++)
+	{
+		if (i == deepest || i == furthest)
+		{
+			continue;
+		}
+
+		const float area = edge.Cross(points[i] - points[deepest]).Dot(normal);
+		if (minArea == -1 || area < minValue)
+		{
+			minArea = i;
+			minValue = area;
+		}
+		if (maxArea == -1 || area > maxValue)
+		{
+			maxArea = i;
+			maxValue = area;
+		}
+	}
+
+	int numKept = 0;
+	kept[numKept++] = deepest;
+	kept[numKept++] = furthest;
+	if (minArea != -1)
+	{
+		kept[numKept++] = minArea;
+	}
+	if (maxArea != -1 && maxArea != minArea)
+	{
+		kept[numKept++] = maxArea;
+	}
+	return numKept;
+}
@@ -0,0 +1,27 @@
+//
+//	ContactClipping.h
+//
+#pragma once
+#include "../Math/Vector.h"
+
+static const int MAX_REDUCED_CONTACTS = 4;
+
+// Face contacts of A are preferred over those of B, and faces over edges. Another feature has to be clearly better
+// to be picked, so resting shapes don't flip between features. The absolute part is a fraction of the size of the
+// smaller shape, so shallow contacts between small shapes can still pick any feature.
+static const float FEATURE_RELATIVE_TOLERANCE = 0.95f;
+static const float FEATURE_ABSOLUTE_TOLERANCE = 0.002f;
+
+// Size is half the thinnest width of the smaller shape
+inline bool IsFeatureClearlyBetter(const float separation, const float bestSeparation, const float size)
+{
+	return separation > FEATURE_RELATIVE_TOLERANCE * bestSeparation + FEATURE_ABSOLUTE_TOLERANCE * size;
+}
+
+// Clips the polygon against a plane, keeping the part where normal.Dot(pt) <= offset. The output needs room for
+// one more point than the input.
+int ClipPolygon(const Vec3* points, const int num, const Vec3& normal, const float offset, Vec3* clipped);
+
+// Picks at most MAX_REDUCED_CONTACTS of the points that keep the deepest one and cover the largest area. Writes the
+// indices of the kept points and returns how many were kept.
+int ReduceContacts(const Vec3* points, const float* depths, const int num, const Vec3& normal, int* kept);
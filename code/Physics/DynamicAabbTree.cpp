@@ -0,0 +1,501 @@
+//
+//  DynamicAabbTree.cpp
+//
+#include "DynamicAabbTree.h"
+#include "Broadphase.h"
+#include "ThreadPool.h"
+
+Bounds UnionBounds(const Bounds& a, const Bounds& b)
+{
+	Bounds result = a;
+	result.Expand(b);
+	return result;
+}
+
+float SurfaceArea(const Bounds& bounds)
+{
+	const float dx = bounds.WidthX();
+	const float dy = bounds.WidthY();
+	const float dz = bounds.WidthZ();
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+bool ContainsBounds(const Bounds& outer, const Bounds& inner)
+{
+	return outer.mins.x <= inner.mins.x && outer.mins.y <= inner.mins.y && outer.mins.z <= inner.mins.z &&
+		outer.maxs.x >= inner.maxs.x && outer.maxs.y >= inner.maxs.y && outer.maxs.z >= inner.maxs.z;
+}
+
+Bounds FattenBounds(const Bounds& bounds, const Vec3& displacement)
+{
+	const float margin = DynamicAabbTree::s_margin;
+	Bounds fat = bounds;
+	fat.mins -= Vec3(margin, margin, margin);
+	fat.maxs += Vec3(margin, margin, margin);
+
+	// Predict the motion so that moving bodies are not re-inserted every frame
+	const Vec3 d = displacement * DynamicAabbTree::s_displacementMultiplier;
+	fat.Expand(fat.mins + d);
+	fat.Expand(fat.maxs + d);
+	return fat;
+}
+
+/*
+====================================================
+DynamicAabbTree::DynamicAabbTree
+====================================================
+*/
+DynamicAabbTree::DynamicAabbTree() :
+	m_root(-1),
+	m_freeList(-1),
+	m_numRejectedPairs(0)
+{}
+
+/*
+====================================================
+DynamicAabbTree::Clear
+====================================================
+*/
+void DynamicAabbTree::Clear()
+{
+	m_nodes.clear();
+	m_bodyProxies.clear();
+	m_bounds.clear();
+	m_root = -1;
+	m_freeList = -1;
+}
+
+/*
+====================================================
+DynamicAabbTree::AllocateNode
+====================================================
+*/
+int DynamicAabbTree::AllocateNode()
+{
+	int nodeId = m_freeList;
+	if (nodeId == -1)
+	{
+		nodeId = (int)m_nodes.size();
+		m_nodes.emplace_back();
+	}
+	else
+	{
+		m_freeList = m_nodes[nodeId].parent;
+	}
+
+	treeNode_t& node = m_nodes[nodeId];
+	node.parent = -1;
+	node.left = -1;
+	node.right = -1;
+	node.height = 0;
+	node.bodyId = -1;
+	return nodeId;
+}
+
+/*
+====================================================
+DynamicAabbTree::FreeNode
+====================================================
+*/
+void DynamicAabbTree::FreeNode(const int nodeId)
+{
+	m_nodes[nodeId].parent = m_freeList;
+	m_nodes[nodeId].height = -1;
+	m_freeList = nodeId;
+}
+
+/*
+====================================================
+DynamicAabbTree::Insert
+====================================================
+*/
+int DynamicAabbTree::Insert(const Bounds& bounds, const int bodyId)
+{
+	const int proxyId = AllocateNode();
+	m_nodes[proxyId].bounds = FattenBounds(bounds, Vec3(0, 0, 0));
+	m_nodes[proxyId].bodyId = bodyId;
+	InsertLeaf(proxyId);
+	return proxyId;
+}
+
+/*
+====================================================
+DynamicAabbTree::Remove
+====================================================
+*/
+void DynamicAabbTree::Remove(const int proxyId)
+{
+	assert(m_nodes[proxyId].IsLeaf());
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+}
+
+/*
+====================================================
+DynamicAabbTree::Refit
+====================================================
+*/
+bool DynamicAabbTree::Refit(const int proxyId, const Bounds& bounds, const Vec3& displacement)
+{
+	assert(m_nodes[proxyId].IsLeaf());
+	if (ContainsBounds(m_nodes[proxyId].bounds, bounds))
+	{
+		return false;
+	}
+
+	RemoveLeaf(proxyId);
+	m_nodes[proxyId].bounds = FattenBounds(bounds, displacement);
+	InsertLeaf(proxyId);
+	return true;
+}
+
+/*
+====================================================
+DynamicAabbTree::InsertLeaf
+====================================================
+*/
+void DynamicAabbTree::InsertLeaf(const int leafId)
+{
+	if (m_root == -1)
+	{
+		m_root = leafId;
+		m_nodes[leafId].parent = -1;
+		return;
+	}
+
+	// Walk down the tree picking the child that grows the least in surface area
+	const Bounds leafBounds = m_nodes[leafId].bounds;
+	int index = m_root;
+	while (!m_nodes[index].IsLeaf())
+	{
+		const treeNode_t& node = m_nodes[index];
+		const float area = SurfaceArea(node.bounds);
+		const float combinedArea = SurfaceArea(UnionBounds(node.bounds, leafBounds));
+
+		// Cost of creating a new parent for this node and the new leaf
+		const float cost = 2.0f * combinedArea;
+		// Minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		const int children[2] = { node.left, node.right };
+		for (int i = 0; i < 2; i++)
+		{
+			const treeNode_t& child = m_nodes[children[i]];
+			const float childArea = SurfaceArea(UnionBounds(child.bounds, leafBounds));
+			childCosts[i] = child.IsLeaf() ? childArea : (childArea - SurfaceArea(child.bounds));
+			childCosts[i] += inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+		{
+			break;
+		}
+		index = (childCosts[0] < childCosts[1]) ? node.left : node.right;
+	}
+
+	// Create a new parent for the sibling and the leaf
+	const int siblingId = index;
+	const int oldParentId = m_nodes[siblingId].parent;
+	const int newParentId = AllocateNode();
+
+	treeNode_t& newParent = m_nodes[newParentId];
+	newParent.parent = oldParentId;
+	newParent.bounds = UnionBounds(leafBounds, m_nodes[siblingId].bounds);
+	newParent.height = m_nodes[siblingId].height + 1;
+	newParent.left = siblingId;
+	newParent.right = leafId;
+
+	if (oldParentId != -1)
+	{
+		if (m_nodes[oldParentId].left == siblingId)
+		{
+			m_nodes[oldParentId].left = newParentId;
+		}
+		else
+		{
+			m_nodes[oldParentId].right = newParentId;
+		}
+	}
+	else
+	{
+		m_root = newParentId;
+	}
+	m_nodes[siblingId].parent = newParentId;
+	m_nodes[leafId].parent = newParentId;
+
+	FixUpwards(newParentId);
+}
+
+/*
+====================================================
+DynamicAabbTree::RemoveLeaf
+====================================================
+*/
+void DynamicAabbTree::RemoveLeaf(const int leafId)
+{
+	if (leafId == m_root)
+	{
+		m_root = -1;
+		return;
+	}
+
+	// The sibling takes the place of the parent
+	const int parentId = m_nodes[leafId].parent;
+	const int grandParentId = m_nodes[parentId].parent;
+	const int siblingId = (m_nodes[parentId].left == leafId) ? m_nodes[parentId].right : m_nodes[parentId].left;
+
+	if (grandParentId != -1)
+	{
+		if (m_nodes[grandParentId].left == parentId)
+		{
+			m_nodes[grandParentId].left = siblingId;
+		}
+		else
+		{
+			m_nodes[grandParentId].right = siblingId;
+		}
+		m_nodes[siblingId].parent = grandParentId;
+		FreeNode(parentId);
+
+		FixUpwards(grandParentId);
+	}
+	else
+	{
+		m_root = siblingId;
+		m_nodes[siblingId].parent = -1;
+		FreeNode(parentId);
+	}
+}
+
+/*
+====================================================
+DynamicAabbTree::FixUpwards
+====================================================
+*/
+void DynamicAabbTree::FixUpwards(int nodeId)
+{
+	// Rebalance and refit the bounds of all the ancestors
+	while (nodeId != -1)
+	{
+		nodeId = Balance(nodeId);
+
+		treeNode_t& node = m_nodes[nodeId];
+		const treeNode_t& left = m_nodes[node.left];
+		const treeNode_t& right = m_nodes[node.right];
+		node.height = 1 + std::max(left.height, right.height);
+		node.bounds = UnionBounds(left.bounds, right.bounds);
+
+		nodeId = node.parent;
+	}
+}
+
+/*
+====================================================
+DynamicAabbTree::Balance
+
+Performs a left or right rotation if the node is imbalanced and returns the new root of the subtree
+====================================================
+*/
+int DynamicAabbTree::Balance(const int nodeId)
+{
+	treeNode_t& a = m_nodes[nodeId];
+	if (a.IsLeaf() || a.height < 2)
+	{
+		return nodeId;
+	}
+
+	const int idB = a.left;
+	const int idC = a.right;
+	const int balance = m_nodes[idC].height - m_nodes[idB].height;
+	if (balance >= -1 && balance <= 1)
+	{
+		return nodeId;
+	}
+
+	// Promote the taller child
+	const int idUp = (balance > 1) ? idC : idB;
+	const int idOther = (balance > 1) ? idB : idC;
+	treeNode_t& up = m_nodes[idUp];
+	const int idF = up.left;
+	const int idG = up.right;
+
+	up.left = nodeId;
+	up.parent = a.parent;
+	a.parent = idUp;
+
+	if (up.parent != -1)
+	{
+		if (m_nodes[up.parent].left == nodeId)
+		{
+			m_nodes[up.parent].left = idUp;
+		}
+		else
+		{
+			m_nodes[up.parent].right = idUp;
+		}
+	}
+	else
+	{
+		m_root = idUp;
+	}
+
+	// The taller grandchild stays with the promoted node, the shorter one moves down to the old root
+	const bool keepF = m_nodes[idF].height > m_nodes[idG].height;
+	const int idKeep = keepF ? idF : idG;
+	const int idMove = keepF ? idG : idF;
+
+	up.right = idKeep;
+	a.left = idOther;
+	a.right = idMove;
+	m_nodes[idMove].parent = nodeId;
+
+	a.bounds = UnionBounds(m_nodes[idOther].bounds, m_nodes[idMove].bounds);
+	a.height = 1 + std::max(m_nodes[idOther].height, m_nodes[idMove].height);
+	up.bounds = UnionBounds(a.bounds, m_nodes[idKeep].bounds);
+	up.height = 1 + std::max(a.height, m_nodes[idKeep].height);
+
+	return idUp;
+}
+
+/*
+====================================================
+DynamicAabbTree::Query
+====================================================
+*/
+void DynamicAabbTree::Query(const Bounds& bounds, std::vector<int>& bodyIds) const
+{
+	Query(bounds, bodyIds, m_queryStack);
+}
+
+/*
+====================================================
+DynamicAabbTree::Query
+====================================================
+*/
+void DynamicAabbTree::Query(const Bounds& bounds, std::vector<int>& bodyIds, std::vector<int>& stack) const
+{
+	if (m_root == -1)
+	{
+		return;
+	}
+
+	stack.clear();
+	stack.push_back(m_root);
+	while (!stack.empty())
+	{
+		const int nodeId = stack.back();
+		stack.pop_back();
+
+		const treeNode_t& node = m_nodes[nodeId];
+		if (!node.bounds.DoesIntersect(bounds))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			bodyIds.push_back(node.bodyId);
+		}
+		else
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+/*
+====================================================
+DynamicAabbTree::Update
+====================================================
+*/
+void DynamicAabbTree::Update(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec)
+{
+	// Proxies are mapped to bodies by their index in bodyIds, so any change in the body count invalidates the tree
+	const bool rebuild = (m_bodyProxies.size() != num);
+	if (rebuild)
+	{
+		Clear();
+		m_bodyProxies.resize(num);
+	}
+	m_bounds.resize(num);
+
+	for (int i = 0; i < num; i++)
+	{
+		const Body& body = bodies[bodyIds[i]];
+		const Bounds bounds = SweptBounds(body, worldBounds.Get(bodyIds[i]), dt_sec);
+		const Vec3 displacement = body.m_linearVelocity * dt_sec;
+		m_bounds[i] = bounds;
+
+		if (rebuild)
+		{
+			m_bodyProxies[i] = Insert(bounds, i);
+		}
+		else
+		{
+			Refit(m_bodyProxies[i], bounds, displacement);
+		}
+	}
+}
+
+/*
+====================================================
+DynamicAabbTree::BuildPairs
+====================================================
+*/
+void DynamicAabbTree::BuildPairs(std::vector<collisionPair_t>& collisionPairs)
+{
+	collisionPairs.clear();
+	m_numRejectedPairs = 0;
+
+	const int num = (int)m_bodyProxies.size();
+	const int numChunks = ThreadPool::Get().GetNumChunks(num, MIN_BODIES_PER_CHUNK);
+	if (m_pairBuffers.size() < numChunks)
+	{
+		m_pairBuffers.resize(numChunks);
+	}
+
+	// The tree is only read here, so every chunk queries it with its own stack
+	ParallelFor(num, MIN_BODIES_PER_CHUNK, [&](const int begin, const int end, const int chunk)
+	{
+		pairBuffer_t& buffer = m_pairBuffers[chunk];
+		buffer.pairs.clear();
+		buffer.numRejected = 0;
+
+		std::vector<int>& overlaps = buffer.scratch;
+		for (int i = begin; i < end; i++)
+		{
+			overlaps.clear();
+			Query(m_nodes[m_bodyProxies[i]].bounds, overlaps, buffer.stack);
+
+			// Only keep the pairs where this body has the lower index, so every pair is emitted once
+			std::sort(overlaps.begin(), overlaps.end());
+			for (const int other : overlaps)
+			{
+				if (other <= i)
+				{
+					continue;
+				}
+
+				// The leaves hold fattened bounds, so do the exact test before emitting the pair
+				if (!m_bounds[i].DoesIntersect(m_bounds[other]))
+				{
+					buffer.numRejected++;
+					continue;
+				}
+
+				collisionPair_t pair;
+				pair.a = i;
+				pair.b = other;
+				buffer.pairs.push_back(pair);
+			}
+		}
+	});
+
+	MergePairBuffers(m_pairBuffers, numChunks, collisionPairs);
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		m_numRejectedPairs += m_pairBuffers[chunk].numRejected;
+	}
+}
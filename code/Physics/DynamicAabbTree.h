@@ -0,0 +1,83 @@
+//
+//	DynamicAabbTree.h
+//
+#pragma once
+#include "../Math/Bounds.h"
+#include "Body.h"
+#include "CollisionPair.h"
+#include <vector>
+
+struct treeNode_t
+{
+	Bounds bounds;	// Fattened bounds for leaves, union of the children for internal nodes
+
+	int parent;	// Also used as the next index while the node is in the free list
+	int left;
+	int right;
+	int height;	// Leaves have height 0, free nodes have height -1
+
+	int bodyId;	// Only valid for leaves
+
+	bool IsLeaf() const { return left == -1; }
+};
+
+/*
+====================================================
+DynamicAabbTree
+
+Bounding volume tree over fattened body bounds. A leaf is only re-inserted once its body leaves the fattened
+bounds, so resting and slowly moving bodies do not touch the tree at all.
+====================================================
+*/
+class DynamicAabbTree
+{
+public:
+	DynamicAabbTree();
+
+	void Clear();
+
+	int Insert(const Bounds& bounds, const int bodyId);
+	void Remove(const int proxyId);
+	// Returns true if the proxy had to be re-inserted because the bounds escaped its fattened bounds
+	bool Refit(const int proxyId, const Bounds& bounds, const Vec3& displacement);
+
+	// Collects the ids of all the bodies whose fattened bounds overlap the given bounds
+	void Query(const Bounds& bounds, std::vector<int>& bodyIds) const;
+	// Same as above with a caller owned traversal stack, so several threads can query the tree at once
+	void Query(const Bounds& bounds, std::vector<int>& bodyIds, std::vector<int>& stack) const;
+
+	void Update(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec);
+	// Pairs are only emitted when the swept bounds of the bodies overlap, not just their fattened bounds
+	void BuildPairs(std::vector<collisionPair_t>& collisionPairs);
+
+	// Number of pairs whose fattened bounds overlapped but were rejected by the exact test in the last BuildPairs
+	int GetNumRejectedPairs() const { return m_numRejectedPairs; }
+
+	int GetHeight() const { return (m_root == -1) ? 0 : m_nodes[m_root].height; }
+
+	// How far the bounds are fattened in every direction
+	static constexpr float s_margin = 0.1f;
+	// How many frames worth of linear displacement are added to the fattened bounds
+	static constexpr float s_displacementMultiplier = 2.0f;
+
+	static const int MIN_BODIES_PER_CHUNK = 256;
+
+private:
+	int AllocateNode();
+	void FreeNode(const int nodeId);
+
+	void InsertLeaf(const int leafId);
+	void RemoveLeaf(const int leafId);
+	int Balance(const int nodeId);
+	void FixUpwards(int nodeId);
+
+	std::vector<treeNode_t> m_nodes;
+	int m_root;
+	int m_freeList;
+
+	std::vector<int> m_bodyProxies;	// Body index to leaf node index
+	std::vector<Bounds> m_bounds;	// Swept bounds of the bodies in the last Update
+	mutable std::vector<int> m_queryStack;
+	std::vector<pairBuffer_t> m_pairBuffers;
+	int m_numRejectedPairs;
+};
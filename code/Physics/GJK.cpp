@@ -2,34 +2,1126 @@
 //  GJK.cpp
 //
 #include "GJK.h"
+#include <algorithm>
+#include <float.h>
+
+/*
+================================================================================================
+
+Signed Volumes
+
+================================================================================================
+*/
 
 /*
 ================================
-GJK_DoesIntersect
+SignedVolume1D
+
+Barycentric coordinates of the point of the segment closest to the origin
+================================
+*/
+Vec2 SignedVolume1D( const Vec3 & s1, const Vec3 & s2 ) {
+	const Vec3 ab = s2 - s1;
+	const Vec3 ap = Vec3( 0.0f ) - s1;
+	const Vec3 p0 = s1 + ab * ab.Dot( ap ) / ab.GetLengthSqr();	// Projection of the origin onto the line
+
+	// Choose the axis with the greatest length
+	int idx = 0;
+	float mu_max = 0;
+	for ( int i = 0; i < 3; i++ ) {
+		const float mu = s2[ i ] - s1[ i ];
+		if ( mu * mu > mu_max * mu_max ) {
+			mu_max = mu;
+			idx = i;
+		}
+	}
+
+	// Project the simplex points and the projected origin onto that axis
+	const float a = s1[ idx ];
+	const float b = s2[ idx ];
+	const float p = p0[ idx ];
+
+	const float C1 = p - a;
+	const float C2 = b - p;
+
+	// The projected origin is between a and b
+	if ( ( p > a && p < b ) || ( p > b && p < a ) ) {
+		return Vec2( C2 / mu_max, C1 / mu_max );
+	}
+
+	// The projected origin is on the far side of a
+	if ( ( a <= b && p <= a ) || ( a >= b && p >= a ) ) {
+		return Vec2( 1.0f, 0.0f );
+	}
+
+	// The projected origin is on the far side of b
+	return Vec2( 0.0f, 1.0f );
+}
+
+/*
+================================
+CompareSigns
+================================
+*/
+static bool CompareSigns( const float a, const float b ) {
+	return ( a > 0.0f && b > 0.0f ) || ( a < 0.0f && b < 0.0f );
+}
+
+/*
+================================
+SignedVolume2D
+
+Barycentric coordinates of the point of the triangle closest to the origin
+================================
+*/
+Vec3 SignedVolume2D( const Vec3 & s1, const Vec3 & s2, const Vec3 & s3 ) {
+	const Vec3 normal = ( s2 - s1 ).Cross( s3 - s1 );
+	const Vec3 p0 = normal * s1.Dot( normal ) / normal.GetLengthSqr();
+
+	// Find the axis plane with the greatest projected area
+	int idx = 0;
+	float area_max = 0;
+	for ( int i = 0; i < 3; i++ ) {
+		const int j = ( i + 1 ) % 3;
+		const int k = ( i + 2 ) % 3;
+
+		const Vec2 a = Vec2( s1[ j ], s1[ k ] );
+		const Vec2 b = Vec2( s2[ j ], s2[ k ] );
+		const Vec2 c = Vec2( s3[ j ], s3[ k ] );
+		const Vec2 ab = b - a;
+		const Vec2 ac = c - a;
+
+		const float area = ab.x * ac.y - ab.y * ac.x;
+		if ( area * area > area_max * area_max ) {
+			idx = i;
+			area_max = area;
+		}
+	}
+
+	// Project onto that plane
+	const int x = ( idx + 1 ) % 3;
+	const int y = ( idx + 2 ) % 3;
+	Vec2 s[ 3 ];
+	s[ 0 ] = Vec2( s1[ x ], s1[ y ] );
+	s[ 1 ] = Vec2( s2[ x ], s2[ y ] );
+	s[ 2 ] = Vec2( s3[ x ], s3[ y ] );
+	const Vec2 p = Vec2( p0[ x ], p0[ y ] );
+
+	// Areas of the triangles formed by the projected origin and the edges
+	Vec3 areas;
+	for ( int i = 0; i < 3; i++ ) {
+		const int j = ( i + 1 ) % 3;
+		const int k = ( i + 2 ) % 3;
+
+		const Vec2 ab = s[ j ] - p;
+		const Vec2 ac = s[ k ] - p;
+		areas[ i ] = ab.x * ac.y - ab.y * ac.x;
+	}
+
+	// The projected origin is inside the triangle
+	if ( CompareSigns( area_max, areas[ 0 ] ) && CompareSigns( area_max, areas[ 1 ] ) && CompareSigns( area_max, areas[ 2 ] ) ) {
+		return areas / area_max;
+	}
+
+	// Otherwise the closest point is on one of the edges
+	const Vec3 edgePts[ 3 ] = { s1, s2, s3 };
+	float dist = 1e10f;
+	Vec3 lambdas = Vec3( 1, 0, 0 );
+	for ( int i = 0; i < 3; i++ ) {
+		const int k = ( i + 1 ) % 3;
+		const int l = ( i + 2 ) % 3;
+
+		const Vec2 lambdaEdge = SignedVolume1D( edgePts[ k ], edgePts[ l ] );
+		const Vec3 pt = edgePts[ k ] * lambdaEdge[ 0 ] + edgePts[ l ] * lambdaEdge[ 1 ];
+		if ( pt.GetLengthSqr() < dist ) {
+			dist = pt.GetLengthSqr();
+			lambdas[ i ] = 0;
+			lambdas[ k ] = lambdaEdge[ 0 ];
+			lambdas[ l ] = lambdaEdge[ 1 ];
+		}
+	}
+	return lambdas;
+}
+
+/*
+================================
+SignedVolume3D
+
+Barycentric coordinates of the point of the tetrahedron closest to the origin
 ================================
 */
-bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB ) {
-	// TODO: Add code
+Vec4 SignedVolume3D( const Vec3 & s1, const Vec3 & s2, const Vec3 & s3, const Vec3 & s4 ) {
+	Mat4 M;
+	M.rows[ 0 ] = Vec4( s1.x, s2.x, s3.x, s4.x );
+	M.rows[ 1 ] = Vec4( s1.y, s2.y, s3.y, s4.y );
+	M.rows[ 2 ] = Vec4( s1.z, s2.z, s3.z, s4.z );
+	M.rows[ 3 ] = Vec4( 1.0f, 1.0f, 1.0f, 1.0f );
+
+	Vec4 C4;
+	C4[ 0 ] = M.Cofactor( 3, 0 );
+	C4[ 1 ] = M.Cofactor( 3, 1 );
+	C4[ 2 ] = M.Cofactor( 3, 2 );
+	C4[ 3 ] = M.Cofactor( 3, 3 );
+
+	const float detM = C4[ 0 ] + C4[ 1 ] + C4[ 2 ] + C4[ 3 ];
+
+	// The origin is inside the tetrahedron
+	if ( CompareSigns( detM, C4[ 0 ] ) && CompareSigns( detM, C4[ 1 ] ) && CompareSigns( detM, C4[ 2 ] ) && CompareSigns( detM, C4[ 3 ] ) ) {
+		return C4 * ( 1.0f / detM );
+	}
+
+	// Otherwise the closest point is on one of the faces
+	const Vec3 facePts[ 4 ] = { s1, s2, s3, s4 };
+	Vec4 lambdas;
+	float dist = 1e10f;
+	for ( int i = 0; i < 4; i++ ) {
+		const int j = ( i + 1 ) % 4;
+		const int k = ( i + 2 ) % 4;
+
+		const Vec3 lambdasFace = SignedVolume2D( facePts[ i ], facePts[ j ], facePts[ k ] );
+		const Vec3 pt = facePts[ i ] * lambdasFace[ 0 ] + facePts[ j ] * lambdasFace[ 1 ] + facePts[ k ] * lambdasFace[ 2 ];
+		if ( pt.GetLengthSqr() < dist ) {
+			dist = pt.GetLengthSqr();
+			lambdas.Zero();
+			lambdas[ i ] = lambdasFace[ 0 ];
+			lambdas[ j ] = lambdasFace[ 1 ];
+			lambdas[ k ] = lambdasFace[ 2 ];
+		}
+	}
+	return lambdas;
+}
+
+/*
+================================================================================================
+
+Gilbert Johnson Keerthi
+
+================================================================================================
+*/
+
+struct point_t {
+	Vec3 xyz;	// The point on the minkowski difference
+	Vec3 ptA;	// The point on bodyA
+	Vec3 ptB;	// The point on bodyB
+};
 
+/*
+================================
+SimplexSignedVolumes
+
+Projects the origin onto the simplex, the new search direction points from the projection to the origin.
+Returns true if the origin is inside the simplex.
+================================
+*/
+static bool SimplexSignedVolumes( const point_t * pts, const int num, Vec3 & newDir, Vec4 & lambdasOut ) {
+	const float epsilonf = 0.0001f * 0.0001f;
+	lambdasOut.Zero();
+
+	switch ( num ) {
+		default:
+		case 2: {
+			const Vec2 lambdas = SignedVolume1D( pts[ 0 ].xyz, pts[ 1 ].xyz );
+			lambdasOut[ 0 ] = lambdas[ 0 ];
+			lambdasOut[ 1 ] = lambdas[ 1 ];
+		} break;
+		case 3: {
+			const Vec3 lambdas = SignedVolume2D( pts[ 0 ].xyz, pts[ 1 ].xyz, pts[ 2 ].xyz );
+			lambdasOut[ 0 ] = lambdas[ 0 ];
+			lambdasOut[ 1 ] = lambdas[ 1 ];
+			lambdasOut[ 2 ] = lambdas[ 2 ];
+		} break;
+		case 4: {
+			lambdasOut = SignedVolume3D( pts[ 0 ].xyz, pts[ 1 ].xyz, pts[ 2 ].xyz, pts[ 3 ].xyz );
+		} break;
+	};
+
+	Vec3 v( 0.0f );
+	for ( int i = 0; i < num; i++ ) {
+		v += pts[ i ].xyz * lambdasOut[ i ];
+	}
+	newDir = v * -1.0f;
+	return ( v.GetLengthSqr() < epsilonf );
+}
+
+/*
+================================
+HasPoint
+
+Checks whether the new point already exists in the simplex
+================================
+*/
+static bool HasPoint( const point_t * simplexPoints, const int num, const point_t & newPt ) {
+	const float precision = 1e-6f;
+
+	for ( int i = 0; i < num; i++ ) {
+		const Vec3 delta = simplexPoints[ i ].xyz - newPt.xyz;
+		if ( delta.GetLengthSqr() < precision * precision ) {
+			return true;
+		}
+	}
 	return false;
 }
 
+/*
+================================
+SortValids
+
+Moves the points that support the projection of the origin to the front of the simplex, returns how many there are
+================================
+*/
+static int SortValids( point_t simplexPoints[ 4 ], Vec4 & lambdas ) {
+	int numValids = 0;
+	for ( int i = 0; i < 4; i++ ) {
+		if ( 0.0f != lambdas[ i ] ) {
+			simplexPoints[ numValids ] = simplexPoints[ i ];
+			lambdas[ numValids ] = lambdas[ i ];
+			numValids++;
+		}
+	}
+	for ( int i = numValids; i < 4; i++ ) {
+		lambdas[ i ] = 0.0f;
+	}
+	return numValids;
+}
+
+/*
+================================
+GJK_ClosestSimplex
+
+Shrinks the simplex towards the origin until it stops getting closer. support returns the point of the minkowski
+difference furthest along a direction. The simplex may come in with points from an earlier query, otherwise numPts
+is 0. When stopWhenSeparated is set, the search ends as soon as a support point fails to pass the origin.
+
+Returns true if the origin ended up inside the simplex, otherwise the lambdas give the closest point.
+================================
+*/
+template< typename supportFunc_t >
+static bool GJK_ClosestSimplex( const supportFunc_t & support, const bool stopWhenSeparated, point_t simplexPoints[ 4 ], int & numPts, Vec4 & lambdas, int & numIterations ) {
+	Vec3 newDir;
+	numIterations = 0;
+	if ( numPts > 1 ) {
+		if ( SimplexSignedVolumes( simplexPoints, numPts, newDir, lambdas ) ) {
+			numPts = SortValids( simplexPoints, lambdas );
+			return true;
+		}
+		numPts = SortValids( simplexPoints, lambdas );
+
+		// The cached points may have become degenerate as the bodies moved
+		if ( !newDir.IsValid() ) {
+			numPts = 0;
+		}
+	}
+	if ( 0 == numPts ) {
+		simplexPoints[ 0 ] = support( Vec3( 1, 1, 1 ) );
+		numPts = 1;
+		numIterations++;
+	}
+	if ( 1 == numPts ) {
+		lambdas = Vec4( 1, 0, 0, 0 );
+		newDir = simplexPoints[ 0 ].xyz * -1.0f;
+	}
+
+	float closestDist = newDir.GetLengthSqr();
+	while ( numPts < 4 ) {
+		if ( newDir.GetLengthSqr() == 0.0f ) {
+			// The origin is on the simplex
+			return true;
+		}
+
+		const point_t newPt = support( newDir );
+		numIterations++;
+
+		// If the new point is already in the simplex, then we can't get any closer
+		if ( HasPoint( simplexPoints, numPts, newPt ) ) {
+			break;
+		}
+
+		// If the new point didn't get past the origin, then the direction separates the shapes
+		if ( stopWhenSeparated && newDir.Dot( newPt.xyz ) < 0.0f ) {
+			break;
+		}
+
+		simplexPoints[ numPts ] = newPt;
+		numPts++;
+
+		const bool doesContainOrigin = SimplexSignedVolumes( simplexPoints, numPts, newDir, lambdas );
+		numPts = SortValids( simplexPoints, lambdas );
+		if ( doesContainOrigin ) {
+			return true;
+		}
+
+		// Check that the new projection of the origin onto the simplex is closer than the previous. Written so that a
+		// NaN from a body that has blown up also ends the search, every comparison with it is false.
+		const float dist = newDir.GetLengthSqr();
+		if ( !( dist < closestDist ) ) {
+			break;
+		}
+		closestDist = dist;
+	}
+
+	return ( 4 == numPts );
+}
+
+/*
+================================
+LoadSimplex
+
+Moves the cached simplex back into world space with the current transforms of the bodies, pass a null bodyB when
+the second shape is a fixed point. The support searches start where the cached ones ended.
+================================
+*/
+static int LoadSimplex( const Body * bodyA, const Body * bodyB, const Vec3 & ptB, const gjkCache_t * cache, point_t simplexPoints[ 4 ], int supportIdx[ 2 ] ) {
+	supportIdx[ 0 ] = 0;
+	supportIdx[ 1 ] = 0;
+	if ( nullptr == cache ) {
+		return 0;
+	}
+
+	supportIdx[ 0 ] = cache->supportIdxA;
+	supportIdx[ 1 ] = cache->supportIdxB;
+
+	for ( int i = 0; i < cache->numPts; i++ ) {
+		point_t & point = simplexPoints[ i ];
+		point.ptA = bodyA->BodySpaceToWorldSpace( cache->ptsA[ i ] );
+		point.ptB = ( nullptr != bodyB ) ? bodyB->BodySpaceToWorldSpace( cache->ptsB[ i ] ) : ptB;
+		point.xyz = point.ptA - point.ptB;
+	}
+	return cache->numPts;
+}
+
+/*
+================================
+StoreSimplex
+================================
+*/
+static void StoreSimplex( const Body * bodyA, const Body * bodyB, const point_t simplexPoints[ 4 ], const int numPts, const int numIterations, const int supportIdx[ 2 ], gjkCache_t * cache ) {
+	if ( nullptr == cache ) {
+		return;
+	}
+
+	cache->numPts = numPts;
+	cache->numIterations = numIterations;
+	cache->supportIdxA = supportIdx[ 0 ];
+	cache->supportIdxB = supportIdx[ 1 ];
+	for ( int i = 0; i < numPts; i++ ) {
+		cache->ptsA[ i ] = bodyA->WorldSpaceToBodySpace( simplexPoints[ i ].ptA );
+		cache->ptsB[ i ] = ( nullptr != bodyB ) ? bodyB->WorldSpaceToBodySpace( simplexPoints[ i ].ptB ) : Vec3( 0.0f );
+	}
+}
+
+/*
+================================
+SupportPair
+
+Each search starts on the point the last search of the same query ended on, successive directions are close
+================================
+*/
+static point_t SupportPair( const Body * bodyA, const Body * bodyB, Vec3 dir, const float bias, int supportIdx[ 2 ] ) {
+	dir.Normalize();
+
+	point_t point;
+	point.ptA = bodyA->m_shape->SupportFrom( dir, bodyA->m_position, bodyA->m_orientation, bias, supportIdx[ 0 ] );
+	point.ptB = bodyB->m_shape->SupportFrom( dir * -1.0f, bodyB->m_position, bodyB->m_orientation, bias, supportIdx[ 1 ] );
+	point.xyz = point.ptA - point.ptB;
+	return point;
+}
+
+/*
+================================
+GJK_DoesIntersect
+================================
+*/
+bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, gjkCache_t * cache ) {
+	int supportIdx[ 2 ];
+	auto support = [ bodyA, bodyB, &supportIdx ]( const Vec3 & dir ) {
+		return SupportPair( bodyA, bodyB, dir, 0.0f, supportIdx );
+	};
+
+	point_t simplexPoints[ 4 ];
+	int numPts = LoadSimplex( bodyA, bodyB, Vec3( 0.0f ), cache, simplexPoints, supportIdx );
+	Vec4 lambdas;
+	int numIterations;
+	const bool doesIntersect = GJK_ClosestSimplex( support, true, simplexPoints, numPts, lambdas, numIterations );
+
+	StoreSimplex( bodyA, bodyB, simplexPoints, numPts, numIterations, supportIdx, cache );
+	return doesIntersect;
+}
+
+/*
+================================
+SupportCorePair
+================================
+*/
+static point_t SupportCorePair( const Body * bodyA, const Body * bodyB, Vec3 dir, int supportIdx[ 2 ] ) {
+	dir.Normalize();
+
+	point_t point;
+	point.ptA = bodyA->m_shape->SupportCoreFrom( dir, bodyA->m_position, bodyA->m_orientation, supportIdx[ 0 ] );
+	point.ptB = bodyB->m_shape->SupportCoreFrom( dir * -1.0f, bodyB->m_position, bodyB->m_orientation, supportIdx[ 1 ] );
+	point.xyz = point.ptA - point.ptB;
+	return point;
+}
+
+/*
+================================
+ClosestPointsPair
+
+Returns false when the minkowski difference of the support function contains the origin
+================================
+*/
+template< typename pairSupportFunc_t >
+static bool ClosestPointsPair( const pairSupportFunc_t & pairSupport, const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache ) {
+	point_t simplexPoints[ 4 ];
+	int supportIdx[ 2 ];
+	int numPts = LoadSimplex( bodyA, bodyB, Vec3( 0.0f ), cache, simplexPoints, supportIdx );
+
+	auto support = [ &pairSupport, bodyA, bodyB, &supportIdx ]( const Vec3 & dir ) {
+		return pairSupport( bodyA, bodyB, dir, supportIdx );
+	};
+	Vec4 lambdas;
+	int numIterations;
+	const bool isInside = GJK_ClosestSimplex( support, false, simplexPoints, numPts, lambdas, numIterations );
+
+	ptOnA.Zero();
+	ptOnB.Zero();
+	for ( int i = 0; i < numPts; i++ ) {
+		ptOnA += simplexPoints[ i ].ptA * lambdas[ i ];
+		ptOnB += simplexPoints[ i ].ptB * lambdas[ i ];
+	}
+
+	StoreSimplex( bodyA, bodyB, simplexPoints, numPts, numIterations, supportIdx, cache );
+	return !isInside;
+}
+
 /*
 ================================
 GJK_ClosestPoints
 ================================
 */
-void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB ) {
-	// TODO: Add code
+void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache ) {
+	auto pairSupport = []( const Body * bodyA, const Body * bodyB, const Vec3 & dir, int supportIdx[ 2 ] ) {
+		return SupportPair( bodyA, bodyB, dir, 0.0f, supportIdx );
+	};
+	ClosestPointsPair( pairSupport, bodyA, bodyB, ptOnA, ptOnB, cache );
+}
+
+/*
+================================
+GJK_ClosestCorePoints
+================================
+*/
+bool GJK_ClosestCorePoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache ) {
+	return ClosestPointsPair( SupportCorePair, bodyA, bodyB, ptOnA, ptOnB, cache );
+}
+
+/*
+================================
+GJK_ClosestPoint
+================================
+*/
+bool GJK_ClosestPoint( const Body * body, const Vec3 & pt, Vec3 & ptOnBody, gjkCache_t * cache ) {
+	// The minkowski difference of the body and a point is the body moved by the point
+	int supportIdx[ 2 ];
+	auto support = [ body, &pt, &supportIdx ]( Vec3 dir ) {
+		dir.Normalize();
+
+		point_t point;
+		point.ptA = body->m_shape->SupportFrom( dir, body->m_position, body->m_orientation, 0.0f, supportIdx[ 0 ] );
+		point.ptB = pt;
+		point.xyz = point.ptA - pt;
+		return point;
+	};
+
+	point_t simplexPoints[ 4 ];
+	int numPts = LoadSimplex( body, nullptr, pt, cache, simplexPoints, supportIdx );
+	Vec4 lambdas;
+	int numIterations;
+	const bool isInside = GJK_ClosestSimplex( support, false, simplexPoints, numPts, lambdas, numIterations );
+
+	StoreSimplex( body, nullptr, simplexPoints, numPts, numIterations, supportIdx, cache );
+	if ( isInside ) {
+		return false;
+	}
+
+	ptOnBody.Zero();
+	for ( int i = 0; i < numPts; i++ ) {
+		ptOnBody += simplexPoints[ i ].ptA * lambdas[ i ];
+	}
+	return true;
+}
+
+/*
+================================================================================================
+
+Expanding Polytope Algorithm
+
+================================================================================================
+*/
+
+static const int EPA_MAX_POINTS = 128;
+
+// Removed triangles keep their slots until the expansion ends, so this has to cover every triangle ever made
+static const int EPA_MAX_TRIANGLES = 8 * EPA_MAX_POINTS;
+
+// A closed polytope has fewer than 2 triangles per point, and every visible triangle gives at most 3 horizon edges
+static const int EPA_MAX_EDGES = 6 * EPA_MAX_POINTS;
+
+struct epaTriangle_t {
+	int a;
+	int b;
+	int c;
+	Vec3 normal;	// Points away from the origin
+	float distance;	// Distance of the plane of the triangle from the origin
+	bool isRemoved;
+};
+
+struct epaEdge_t {
+	int a;
+	int b;
+};
+
+struct epaHeapEntry_t {
+	float distance;
+	int triangle;
+};
+
+/*
+================================
+epaArena_t
+
+Everything the expansion needs, with a fixed capacity so that deep penetrations don't allocate. The heap keeps the
+triangles ordered by their distance to the origin, entries of removed triangles are dropped when they reach the top.
+================================
+*/
+struct epaArena_t {
+	point_t points[ EPA_MAX_POINTS ];
+	epaTriangle_t triangles[ EPA_MAX_TRIANGLES ];
+	epaHeapEntry_t heap[ EPA_MAX_TRIANGLES ];
+	epaEdge_t edges[ EPA_MAX_EDGES ];
+	int visible[ EPA_MAX_TRIANGLES ];
+
+	int numPoints;
+	int numTriangles;
+	int numHeap;
+	int numEdges;
+};
+
+static thread_local epaArena_t t_epaArena;
+
+static bool IsCloserTriangle( const epaHeapEntry_t & a, const epaHeapEntry_t & b ) {
+	// std heaps keep the largest element on top, so the comparison is reversed
+	return a.distance > b.distance;
+}
+
+/*
+================================
+BarycentricCoordinates
+
+Barycentric coordinates of the projection of pt onto the plane of the triangle, from the signed areas of the
+sub-triangles in the axis plane where the triangle is largest
+================================
+*/
+static Vec3 BarycentricCoordinates( Vec3 s1, Vec3 s2, Vec3 s3, const Vec3 & pt ) {
+	s1 = s1 - pt;
+	s2 = s2 - pt;
+	s3 = s3 - pt;
+
+	const Vec3 normal = ( s2 - s1 ).Cross( s3 - s1 );
+	const Vec3 p0 = normal * s1.Dot( normal ) / normal.GetLengthSqr();
+
+	// Find the axis with the greatest projected area
+	int idx = 0;
+	float areaMax = 0;
+	for ( int i = 0; i < 3; i++ ) {
+		const int j = ( i + 1 ) % 3;
+		const int k = ( i + 2 ) % 3;
+
+		const Vec2 a = Vec2( s1[ j ], s1[ k ] );
+		const Vec2 b = Vec2( s2[ j ], s2[ k ] );
+		const Vec2 c = Vec2( s3[ j ], s3[ k ] );
+		const Vec2 ab = b - a;
+		const Vec2 ac = c - a;
+
+		const float area = ab.x * ac.y - ab.y * ac.x;
+		if ( area * area > areaMax * areaMax ) {
+			idx = i;
+			areaMax = area;
+		}
+	}
+
+	// Project onto the appropriate axis
+	const int x = ( idx + 1 ) % 3;
+	const int y = ( idx + 2 ) % 3;
+	Vec2 s[ 3 ];
+	s[ 0 ] = Vec2( s1[ x ], s1[ y ] );
+	s[ 1 ] = Vec2( s2[ x ], s2[ y ] );
+	s[ 2 ] = Vec2( s3[ x ], s3[ y ] );
+	const Vec2 p = Vec2( p0[ x ], p0[ y ] );
+
+	// Get the sub-areas of the triangles formed from the projected point and the edges
+	Vec3 areas;
+	for ( int i = 0; i < 3; i++ ) {
+		const int j = ( i + 1 ) % 3;
+		const int k = ( i + 2 ) % 3;
+
+		const Vec2 ab = s[ j ] - p;
+		const Vec2 ac = s[ k ] - p;
+		areas[ i ] = ab.x * ac.y - ab.y * ac.x;
+	}
+
+	Vec3 lambdas = areas / areaMax;
+	if ( !lambdas.IsValid() ) {
+		lambdas = Vec3( 1, 0, 0 );
+	}
+	return lambdas;
+}
+
+/*
+================================
+EPA_AddTriangle
+
+The corners have to be wound so that the normal points away from the origin. Slivers are kept to close the
+polytope, but they never become the closest triangle.
+================================
+*/
+static void EPA_AddTriangle( epaArena_t & arena, const int a, const int b, const int c ) {
+	epaTriangle_t & tri = arena.triangles[ arena.numTriangles ];
+	tri.a = a;
+	tri.b = b;
+	tri.c = c;
+	tri.isRemoved = false;
+
+	const Vec3 & ptA = arena.points[ a ].xyz;
+	tri.normal = ( arena.points[ b ].xyz - ptA ).Cross( arena.points[ c ].xyz - ptA );
+	const float lengthSqr = tri.normal.GetLengthSqr();
+	if ( lengthSqr < 1e-12f ) {
+		tri.normal.Zero();
+		tri.distance = FLT_MAX;
+		arena.numTriangles++;
+		return;
+	}
+	tri.normal /= sqrtf( lengthSqr );
+	tri.distance = tri.normal.Dot( ptA );
+
+	epaHeapEntry_t & entry = arena.heap[ arena.numHeap ];
+	entry.distance = tri.distance;
+	entry.triangle = arena.numTriangles;
+	arena.numHeap++;
+	std::push_heap( arena.heap, arena.heap + arena.numHeap, IsCloserTriangle );
+
+	arena.numTriangles++;
+}
+
+/*
+================================
+EPA_ClosestTriangle
+
+Returns -1 when there are no triangles left, which only happens for a degenerate polytope
+================================
+*/
+static int EPA_ClosestTriangle( epaArena_t & arena ) {
+	while ( arena.numHeap > 0 ) {
+		const int idx = arena.heap[ 0 ].triangle;
+		if ( !arena.triangles[ idx ].isRemoved ) {
+			return idx;
+		}
+		std::pop_heap( arena.heap, arena.heap + arena.numHeap, IsCloserTriangle );
+		arena.numHeap--;
+	}
+	return -1;
+}
+
+/*
+================================
+EPA_HasPoint
+================================
+*/
+static bool EPA_HasPoint( const epaArena_t & arena, const Vec3 & w ) {
+	const float epsilons = 0.001f * 0.001f;
+
+	for ( int i = 0; i < arena.numPoints; i++ ) {
+		const Vec3 delta = w - arena.points[ i ].xyz;
+		if ( delta.GetLengthSqr() < epsilons ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+================================
+EPA_AddHorizonEdge
+
+An edge shared by two visible triangles shows up once in each direction, the two cancel out and the edges left
+over are the horizon
+================================
+*/
+static bool EPA_AddHorizonEdge( epaArena_t & arena, const int a, const int b ) {
+	for ( int i = 0; i < arena.numEdges; i++ ) {
+		if ( arena.edges[ i ].a == b && arena.edges[ i ].b == a ) {
+			arena.numEdges--;
+			arena.edges[ i ] = arena.edges[ arena.numEdges ];
+			return true;
+		}
+	}
+
+	if ( arena.numEdges >= EPA_MAX_EDGES ) {
+		return false;
+	}
+	arena.edges[ arena.numEdges ].a = a;
+	arena.edges[ arena.numEdges ].b = b;
+	arena.numEdges++;
+	return true;
+}
+
+/*
+================================
+EPA_AddPoint
+
+Removes the triangles the new point can see and fills the hole with triangles from the horizon to the point.
+Returns false without touching the polytope when nothing is visible or the arena is out of room.
+================================
+*/
+static bool EPA_AddPoint( epaArena_t & arena, const point_t & newPt ) {
+	if ( arena.numPoints >= EPA_MAX_POINTS ) {
+		return false;
+	}
+
+	int numVisible = 0;
+	arena.numEdges = 0;
+	for ( int i = 0; i < arena.numTriangles; i++ ) {
+		const epaTriangle_t & tri = arena.triangles[ i ];
+		if ( tri.isRemoved || tri.normal.Dot( newPt.xyz - arena.points[ tri.a ].xyz ) <= 0.0f ) {
+			continue;
+		}
+
+		arena.visible[ numVisible ] = i;
+		numVisible++;
+		if ( !EPA_AddHorizonEdge( arena, tri.a, tri.b ) || !EPA_AddHorizonEdge( arena, tri.b, tri.c ) || !EPA_AddHorizonEdge( arena, tri.c, tri.a ) ) {
+			return false;
+		}
+	}
+
+	if ( 0 == numVisible || 0 == arena.numEdges || arena.numTriangles + arena.numEdges > EPA_MAX_TRIANGLES ) {
+		return false;
+	}
+
+	for ( int i = 0; i < numVisible; i++ ) {
+		arena.triangles[ arena.visible[ i ] ].isRemoved = true;
+	}
+
+	const int newIdx = arena.numPoints;
+	arena.points[ newIdx ] = newPt;
+	arena.numPoints++;
+
+	// The horizon edges keep the winding of the removed triangles, so the new triangles face outwards as well
+	for ( int i = 0; i < arena.numEdges; i++ ) {
+		EPA_AddTriangle( arena, arena.edges[ i ].a, arena.edges[ i ].b, newIdx );
+	}
+	return true;
+}
+
+/*
+================================
+EPA_Expand
+
+Grows the tetrahedron GJK ended with until its closest face to the origin lies on the surface of the minkowski
+difference. Returns the penetration depth.
+================================
+*/
+static float EPA_Expand( const Body * bodyA, const Body * bodyB, const float bias, const point_t simplexPoints[ 4 ], int supportIdx[ 2 ], Vec3 & ptOnA, Vec3 & ptOnB ) {
+	const float tolerance = 0.0001f;
+
+	epaArena_t & arena = t_epaArena;
+	arena.numPoints = 0;
+	arena.numTriangles = 0;
+	arena.numHeap = 0;
+	arena.numEdges = 0;
+
+	for ( int i = 0; i < 4; i++ ) {
+		arena.points[ i ] = simplexPoints[ i ];
+	}
+	arena.numPoints = 4;
+
+	for ( int i = 0; i < 4; i++ ) {
+		int j = ( i + 1 ) % 4;
+		int k = ( i + 2 ) % 4;
+		const int unusedPt = ( i + 3 ) % 4;
+
+		// The unused point has to be behind the triangle
+		const Vec3 & ptI = arena.points[ i ].xyz;
+		const Vec3 normal = ( arena.points[ j ].xyz - ptI ).Cross( arena.points[ k ].xyz - ptI );
+		if ( normal.Dot( arena.points[ unusedPt ].xyz - ptI ) > 0.0f ) {
+			std::swap( j, k );
+		}
+		EPA_AddTriangle( arena, i, j, k );
+	}
+
+	int closest = EPA_ClosestTriangle( arena );
+	while ( closest >= 0 ) {
+		const epaTriangle_t & tri = arena.triangles[ closest ];
+		const point_t newPt = SupportPair( bodyA, bodyB, tri.normal, bias, supportIdx );
+
+		// The closest triangle is on the surface once the support point doesn't get past it
+		if ( tri.normal.Dot( newPt.xyz ) - tri.distance <= tolerance ) {
+			break;
+		}
+		if ( EPA_HasPoint( arena, newPt.xyz ) ) {
+			break;
+		}
+		if ( !EPA_AddPoint( arena, newPt ) ) {
+			break;
+		}
+
+		closest = EPA_ClosestTriangle( arena );
+	}
+
+	if ( closest < 0 ) {
+		// The simplex was flat, the origin is on the surface
+		ptOnA = simplexPoints[ 0 ].ptA;
+		ptOnB = ptOnA;
+		return 0.0f;
+	}
+
+	// Get the projection of the origin on the closest triangle
+	const epaTriangle_t & tri = arena.triangles[ closest ];
+	const point_t & a = arena.points[ tri.a ];
+	const point_t & b = arena.points[ tri.b ];
+	const point_t & c = arena.points[ tri.c ];
+	const Vec3 lambdas = BarycentricCoordinates( a.xyz, b.xyz, c.xyz, Vec3( 0.0f ) );
+
+	ptOnA = a.ptA * lambdas[ 0 ] + b.ptA * lambdas[ 1 ] + c.ptA * lambdas[ 2 ];
+	ptOnB = a.ptB * lambdas[ 0 ] + b.ptB * lambdas[ 1 ] + c.ptB * lambdas[ 2 ];
+	return ( ptOnB - ptOnA ).GetMagnitude();
 }
 
 /*
 ================================
 GJK_DoesIntersect
+
+Finds the closest face of the minkowski difference to the origin with EPA when the shapes overlap. The shapes are
+grown by the bias, so that shapes that are barely touching still give a tetrahedron with some volume.
 ================================
 */
 bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB ) {
-	// TODO: Add code
+	int supportIdx[ 2 ] = { 0, 0 };
+	auto support = [ bodyA, bodyB, &supportIdx ]( const Vec3 & dir ) {
+		return SupportPair( bodyA, bodyB, dir, 0.0f, supportIdx );
+	};
 
-	return false;
-}
\ No newline at end of file
+	point_t simplexPoints[ 4 ];
+	int numPts = 0;
+	Vec4 lambdas;
+	int numIterations;
+	if ( !GJK_ClosestSimplex( support, true, simplexPoints, numPts, lambdas, numIterations ) ) {
+		return false;
+	}
+
+	// EPA expects a tetrahedron
+	if ( 1 == numPts ) {
+		simplexPoints[ numPts ] = support( simplexPoints[ 0 ].xyz * -1.0f );
+		numPts++;
+	}
+	if ( 2 == numPts ) {
+		const Vec3 ab = simplexPoints[ 1 ].xyz - simplexPoints[ 0 ].xyz;
+		Vec3 u, v;
+		ab.GetOrtho( u, v );
+		simplexPoints[ numPts ] = support( u );
+		numPts++;
+	}
+	if ( 3 == numPts ) {
+		const Vec3 ab = simplexPoints[ 1 ].xyz - simplexPoints[ 0 ].xyz;
+		const Vec3 ac = simplexPoints[ 2 ].xyz - simplexPoints[ 0 ].xyz;
+		simplexPoints[ numPts ] = support( ab.Cross( ac ) );
+		numPts++;
+	}
+
+	// Expand the simplex by the bias, away from its center
+	Vec3 center( 0.0f );
+	for ( int i = 0; i < 4; i++ ) {
+		center += simplexPoints[ i ].xyz;
+	}
+	center *= 0.25f;
+
+	for ( int i = 0; i < 4; i++ ) {
+		point_t & pt = simplexPoints[ i ];
+
+		Vec3 dir = pt.xyz - center;
+		dir.Normalize();
+		pt.ptA += dir * bias;
+		pt.ptB -= dir * bias;
+		pt.xyz = pt.ptA - pt.ptB;
+	}
+
+	EPA_Expand( bodyA, bodyB, bias, simplexPoints, supportIdx, ptOnA, ptOnB );
+	return true;
+}
+
+/*
+================================================================================================
+
+Minkowski Portal Refinement
+
+================================================================================================
+*/
+
+static const int MPR_MAX_ITERATIONS = 64;
+
+/*
+================================
+MPR_PortalNormal
+
+The portal is wound so that its normal points away from the interior point
+================================
+*/
+static Vec3 MPR_PortalNormal( const point_t portal[ 4 ] ) {
+	Vec3 normal = ( portal[ 2 ].xyz - portal[ 1 ].xyz ).Cross( portal[ 3 ].xyz - portal[ 1 ].xyz );
+	normal.Normalize();
+	return normal;
+}
+
+/*
+================================
+MPR_ExpandPortal
+
+Replaces the corner of the portal that keeps the ray from the interior point through the origin inside the portal
+================================
+*/
+static void MPR_ExpandPortal( point_t portal[ 4 ], const point_t & newPt ) {
+	const Vec3 v4v0 = newPt.xyz.Cross( portal[ 0 ].xyz );
+	if ( portal[ 1 ].xyz.Dot( v4v0 ) > 0.0f ) {
+		if ( portal[ 2 ].xyz.Dot( v4v0 ) > 0.0f ) {
+			portal[ 1 ] = newPt;
+		} else {
+			portal[ 3 ] = newPt;
+		}
+	} else {
+		if ( portal[ 3 ].xyz.Dot( v4v0 ) > 0.0f ) {
+			portal[ 2 ] = newPt;
+		} else {
+			portal[ 1 ] = newPt;
+		}
+	}
+}
+
+/*
+================================
+MPR_Penetration
+================================
+*/
+bool MPR_Penetration( const Body * bodyA, const Body * bodyB, Vec3 & normal, float & depth, Vec3 & ptOnA, Vec3 & ptOnB ) {
+	const float tolerance = 0.0001f;
+
+	int supportIdx[ 2 ] = { 0, 0 };
+	auto support = [ bodyA, bodyB, &supportIdx ]( const Vec3 & dir ) {
+		return SupportPair( bodyA, bodyB, dir, 0.0f, supportIdx );
+	};
+
+	// Any point inside the minkowski difference will do, the difference of the centers of mass always is
+	point_t portal[ 4 ];
+	portal[ 0 ].ptA = bodyA->GetCenterOfMassWorldSpace();
+	portal[ 0 ].ptB = bodyB->GetCenterOfMassWorldSpace();
+	portal[ 0 ].xyz = portal[ 0 ].ptA - portal[ 0 ].ptB;
+	if ( portal[ 0 ].xyz.GetLengthSqr() < 1e-10f ) {
+		// The ray needs the interior point to be off the origin to have a direction
+		portal[ 0 ].xyz += Vec3( 1e-4f, 0.0f, 0.0f );
+	}
+
+	//
+	//	Find a portal that the ray from the interior point through the origin passes through
+	//
+
+	Vec3 dir = portal[ 0 ].xyz * -1.0f;
+	portal[ 1 ] = support( dir );
+	if ( portal[ 1 ].xyz.Dot( dir ) <= 0.0f ) {
+		return false;
+	}
+
+	dir = portal[ 0 ].xyz.Cross( portal[ 1 ].xyz );
+	if ( dir.GetLengthSqr() < 1e-12f ) {
+		// The origin is on the segment from the interior point to the support point
+		normal = portal[ 1 ].xyz;
+		normal.Normalize();
+		depth = portal[ 1 ].xyz.Dot( normal );
+		ptOnA = portal[ 1 ].ptA;
+		ptOnB = portal[ 1 ].ptB;
+		return true;
+	}
+
+	portal[ 2 ] = support( dir );
+	if ( portal[ 2 ].xyz.Dot( dir ) <= 0.0f ) {
+		return false;
+	}
+
+	dir = ( portal[ 1 ].xyz - portal[ 0 ].xyz ).Cross( portal[ 2 ].xyz - portal[ 0 ].xyz );
+	if ( dir.Dot( portal[ 0 ].xyz ) > 0.0f ) {
+		std::swap( portal[ 1 ], portal[ 2 ] );
+		dir *= -1.0f;
+	}
+
+	int numIterations = 0;
+	while ( true ) {
+		portal[ 3 ] = support( dir );
+		if ( portal[ 3 ].xyz.Dot( dir ) <= 0.0f ) {
+			return false;
+		}
+
+		if ( portal[ 1 ].xyz.Cross( portal[ 3 ].xyz ).Dot( portal[ 0 ].xyz ) < 0.0f ) {
+			// The origin is outside the side through the interior point, v1 and v3
+			portal[ 2 ] = portal[ 3 ];
+		} else if ( portal[ 3 ].xyz.Cross( portal[ 2 ].xyz ).Dot( portal[ 0 ].xyz ) < 0.0f ) {
+			// The origin is outside the side through the interior point, v3 and v2
+			portal[ 1 ] = portal[ 3 ];
+		} else {
+			break;
+		}
+
+		numIterations++;
+		if ( numIterations >= MPR_MAX_ITERATIONS ) {
+			return false;
+		}
+		dir = ( portal[ 1 ].xyz - portal[ 0 ].xyz ).Cross( portal[ 2 ].xyz - portal[ 0 ].xyz );
+	}
+
+	//
+	//	Move the portal out to the surface of the minkowski difference
+	//
+
+	bool isOnSurface = false;
+	for ( numIterations = 0; numIterations < MPR_MAX_ITERATIONS; numIterations++ ) {
+		normal = MPR_PortalNormal( portal );
+		if ( normal.GetLengthSqr() == 0.0f ) {
+			break;
+		}
+
+		const point_t newPt = support( normal );
+		const float newDist = newPt.xyz.Dot( normal );
+		if ( newDist < 0.0f ) {
+			// The whole minkowski difference is behind the origin
+			return false;
+		}
+
+		const float portalDist = std::max( portal[ 1 ].xyz.Dot( normal ), std::max( portal[ 2 ].xyz.Dot( normal ), portal[ 3 ].xyz.Dot( normal ) ) );
+		if ( newDist - portalDist <= tolerance ) {
+			isOnSurface = true;
+			break;
+		}
+
+		MPR_ExpandPortal( portal, newPt );
+	}
+	if ( !isOnSurface ) {
+		return false;
+	}
+
+	// The origin is inside when it is on the same side of the portal as the interior point
+	normal = MPR_PortalNormal( portal );
+	depth = portal[ 1 ].xyz.Dot( normal );
+	if ( depth < 0.0f || normal.GetLengthSqr() == 0.0f ) {
+		return false;
+	}
+
+	const Vec3 lambdas = SignedVolume2D( portal[ 1 ].xyz, portal[ 2 ].xyz, portal[ 3 ].xyz );
+	ptOnA = portal[ 1 ].ptA * lambdas[ 0 ] + portal[ 2 ].ptA * lambdas[ 1 ] + portal[ 3 ].ptA * lambdas[ 2 ];
+	ptOnB = portal[ 1 ].ptB * lambdas[ 0 ] + portal[ 2 ].ptB * lambdas[ 1 ] + portal[ 3 ].ptB * lambdas[ 2 ];
+	return true;
+}
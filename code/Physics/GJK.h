@@ -9,6 +9,45 @@
 #include "Body.h"
 #include "Shapes.h"
 
-bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB );
+/*
+====================================================
+gjkCache_t
+
+The simplex a GJK query ended with, in the local space of each body. Bodies that barely moved since the last query
+have nearly the same simplex, so starting from it usually ends the search within one or two iterations.
+====================================================
+*/
+struct gjkCache_t {
+	Vec3 ptsA[ 4 ];
+	Vec3 ptsB[ 4 ];
+	int numPts;
+	int numIterations;	// Support calls the last query needed, for measuring how well the warm start works
+	int supportIdxA;	// Points the support searches of the last query ended on, where the next searches start
+	int supportIdxB;
+
+	void Clear() {
+		numPts = 0;
+		numIterations = 0;
+		supportIdxA = 0;
+		supportIdxB = 0;
+	}
+};
+
+// The cache is optional, without it every query starts from an arbitrary direction
+bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, gjkCache_t * cache = nullptr );
 bool GJK_DoesIntersect( const Body * bodyA, const Body * bodyB, const float bias, Vec3 & ptOnA, Vec3 & ptOnB );
-void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB );
+void GJK_ClosestPoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = nullptr );
+
+// Closest points of the cores of the shapes, the shapes without their convex radius. Returns false when the cores
+// overlap. A cache must only be used for core queries, the simplex of the full shapes would be outside the cores.
+bool GJK_ClosestCorePoints( const Body * bodyA, const Body * bodyB, Vec3 & ptOnA, Vec3 & ptOnB, gjkCache_t * cache = nullptr );
+
+// Closest point on the body to a world space point. Returns false when the point is inside the body, then there is
+// no closest point on the surface to give.
+bool GJK_ClosestPoint( const Body * body, const Vec3 & pt, Vec3 & ptOnBody, gjkCache_t * cache = nullptr );
+
+// Minkowski portal refinement, an alternative to GJK and EPA for overlapping shapes. The portal is pushed out along
+// the ray from the centers through the origin, so the normal and depth are those of the surface that ray crosses,
+// which is the least penetration for shallow contacts but not always for deep ones. The normal points from A to B.
+// Also returns false when the portal doesn't reach the surface within a fixed number of iterations.
+bool MPR_Penetration( const Body * bodyA, const Body * bodyB, Vec3 & normal, float & depth, Vec3 & ptOnA, Vec3 & ptOnB );
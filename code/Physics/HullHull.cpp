@@ -0,0 +1,496 @@
+//
+//  HullHull.cpp
+//
+#include "HullHull.h"
+#include <algorithm>
+#include <float.h>
+
+// Incident faces are clipped by every side of the reference face, which adds at most one point per side
+static const int MAX_HULL_CLIP_POINTS = 64;
+
+// Face normals of hull B moved into the space of hull A for the edge query, kept around so the query doesn't allocate
+static thread_local std::vector<Vec3> t_normalsB;
+
+// Maps points from the space of one body into the space of another
+struct relativeTransform_t
+{
+	Quat orient;
+	Vec3 pos;
+
+	Vec3 TransformPoint(const Vec3& pt) const { return orient.RotatePoint(pt) + pos; }
+	Vec3 TransformVector(const Vec3& dir) const { return orient.RotatePoint(dir); }
+};
+
+relativeTransform_t RelativeTransform(const Body* from, const Body* to)
+{
+	const Quat invTo = to->m_orientation.Inverse();
+
+	relativeTransform_t result;
+	result.orient = invTo * from->m_orientation;
+	result.pos = invTo.RotatePoint(from->m_position - to->m_position);
+	return result;
+}
+
+/*
+====================================================
+FaceSeparation
+
+Distance of hull B from the plane of a face of hull A, measured in the space of A. The search for the deepest point
+of B starts from supportIdx, which is set to the point found.
+====================================================
+*/
+float FaceSeparation(const ShapeConvex* hullA, const ShapeConvex* hullB, const relativeTransform_t& aToB, const relativeTransform_t& bToA, const int faceIdx, int& supportIdx)
+{
+	const hullFace_t& face = hullA->m_faces[faceIdx];
+
+	// Find the support point in the space of B, so only the normal has to be rotated
+	const Vec3 normalInB = aToB.TransformVector(face.normal);
+	supportIdx = hullB->SupportIndex(normalInB * -1.0f, supportIdx);
+	return normalInB.Dot(hullB->m_points[supportIdx]) + face.normal.Dot(bToA.pos) - face.distance;
+}
+
+/*
+====================================================
+QueryFaces
+
+Returns false as soon as a face of A separates the hulls, otherwise the face with the largest separation. The
+support point of B for the returned face is written to supportIdx, which is also where the first search starts.
+====================================================
+*/
+bool QueryFaces(const ShapeConvex* hullA, const ShapeConvex* hullB, const relativeTransform_t& aToB, const relativeTransform_t& bToA, float& separation, int& faceIdx, int& supportIdx)
+{
+	separation = -FLT_MAX;
+	faceIdx = -1;
+
+	// Every search starts from the support point of the previous face
+	int walkIdx = supportIdx;
+	for (int i = 0; i < hullA->m_faces.size(); i++)
+	{
+		const float faceSeparation = FaceSeparation(hullA, hullB, aToB, bToA, i, walkIdx);
+		if (faceSeparation > separation)
+		{
+			separation = faceSeparation;
+			faceIdx = i;
+			supportIdx = walkIdx;
+		}
+		if (faceSeparation > 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+====================================================
+IsMinkowskiFace
+
+Tests if the arc between the normals a and b crosses the arc between c and d on the unit sphere. The normals of the
+second hull are passed negated, so crossing arcs mean the two edges build a face of the Minkowski difference.
+====================================================
+*/
+bool IsMinkowskiFace(const Vec3& a, const Vec3& b, const Vec3& c, const Vec3& d)
+{
+	const Vec3 bxa = b.Cross(a);
+	const Vec3 dxc = d.Cross(c);
+
+	const float cba = c.Dot(bxa);
+	const float dba = d.Dot(bxa);
+	const float adc = a.Dot(dxc);
+	const float bdc = b.Dot(dxc);
+
+	// The arcs cross if c and d are on opposite sides of the plane through a and b and the other way around, and
+	// both arcs are on the same hemisphere
+	return (cba * dba < 0.0f) && (adc * bdc < 0.0f) && (cba * bdc > 0.0f);
+}
+
+/*
+====================================================
+EdgeSeparation
+
+Distance between the two edges along their cross product, pointing away from the center of A. Returns -FLT_MAX
+for parallel edges, whose direction is already covered by the faces.
+====================================================
+*/
+float EdgeSeparation(const Vec3& ptA, const Vec3& edgeA, const Vec3& ptB, const Vec3& edgeB, const Vec3& centerA, Vec3& axis)
+{
+	axis = edgeA.Cross(edgeB);
+	const float length = axis.GetMagnitude();
+	const float tolerance = 1e-5f;
+	if (length < tolerance * sqrtf(edgeA.GetLengthSqr() * edgeB.GetLengthSqr()))
+	{
+		return -FLT_MAX;
+	}
+	axis /= length;
+
+	if (axis.Dot(ptA - centerA) < 0.0f)
+	{
+		axis *= -1.0f;
+	}
+	return axis.Dot(ptB - ptA);
+}
+
+/*
+====================================================
+MoveNormalsIntoSpace
+
+Fills the scratch array with the face normals of hull B in the space of A
+====================================================
+*/
+void MoveNormalsIntoSpace(const ShapeConvex* hullB, const relativeTransform_t& bToA)
+{
+	t_normalsB.resize(hullB->m_faces.size());
+	for (int i = 0; i < hullB->m_faces.size(); i++)
+	{
+		t_normalsB[i] = bToA.TransformVector(hullB->m_faces[i].normal);
+	}
+}
+
+float PairEdgeSeparation(const ShapeConvex* hullA, const ShapeConvex* hullB, const relativeTransform_t& bToA, const int edgeIdxA, const int edgeIdxB, Vec3& axis)
+{
+	const hullEdge_t& edgeA = hullA->m_edges[edgeIdxA];
+	const hullEdge_t& edgeB = hullB->m_edges[edgeIdxB];
+
+	const Vec3& ptA = hullA->m_points[edgeA.a];
+	const Vec3 ptB = bToA.TransformPoint(hullB->m_points[edgeB.a]);
+	const Vec3 endB = bToA.TransformPoint(hullB->m_points[edgeB.b]);
+	return EdgeSeparation(ptA, hullA->m_points[edgeA.b] - ptA, ptB, endB - ptB, hullA->GetCenterOfMass(), axis);
+}
+
+/*
+====================================================
+QueryEdges
+
+Expects the face normals of hull B to be in the scratch array. The points of B are only moved into the space of A
+for the edge pairs that build a face of the Minkowski difference. Returns false as soon as an edge pair separates
+the hulls.
+====================================================
+*/
+bool QueryEdges(const ShapeConvex* hullA, const ShapeConvex* hullB, const relativeTransform_t& bToA, float& separation, int& edgeIdxA, int& edgeIdxB, Vec3& normal)
+{
+	separation = -FLT_MAX;
+	edgeIdxA = -1;
+	edgeIdxB = -1;
+	for (int i = 0; i < hullA->m_edges.size(); i++)
+	{
+		const hullEdge_t& edgeA = hullA->m_edges[i];
+		const Vec3& a = hullA->m_faces[edgeA.faceA].normal;
+		const Vec3& b = hullA->m_faces[edgeA.faceB].normal;
+
+		for (int j = 0; j < hullB->m_edges.size(); j++)
+		{
+			const hullEdge_t& edgeB = hullB->m_edges[j];
+			const Vec3 c = t_normalsB[edgeB.faceA] * -1.0f;
+			const Vec3 d = t_normalsB[edgeB.faceB] * -1.0f;
+			if (!IsMinkowskiFace(a, b, c, d))
+			{
+				continue;
+			}
+
+			Vec3 axis;
+			const float edgeSeparation = PairEdgeSeparation(hullA, hullB, bToA, i, j, axis);
+			if (edgeSeparation > separation)
+			{
+				separation = edgeSeparation;
+				edgeIdxA = i;
+				edgeIdxB = j;
+				normal = axis;
+			}
+			if (edgeSeparation > 0.0f)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+====================================================
+ClosestPointsSegments
+====================================================
+*/
+void ClosestPointsSegments(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Vec3& c1, Vec3& c2)
+{
+	const Vec3 d1 = q1 - p1;
+	const Vec3 d2 = q2 - p2;
+	const Vec3 r = p1 - p2;
+	const float a = d1.Dot(d1);
+	const float e = d2.Dot(d2);
+	const float f = d2.Dot(r);
+	const float c = d1.Dot(r);
+	const float b = d1.Dot(d2);
+	const float denom = a * e - b * b;
+
+	float s = (denom > 1e-8f) ? std::max(0.0f, std::min(1.0f, (b * f - c * e) / denom)) : 0.0f;
+	float t = (b * s + f) / e;
+	if (t < 0.0f)
+	{
+		t = 0.0f;
+		s = std::max(0.0f, std::min(1.0f, -c / a));
+	}
+	else if (t > 1.0f)
+	{
+		t = 1.0f;
+		s = std::max(0.0f, std::min(1.0f, (b - c) / a));
+	}
+
+	c1 = p1 + d1 * s;
+	c2 = p2 + d2 * t;
+}
+
+/*
+====================================================
+HullFaceContacts
+
+Clips the incident face against a face of the reference hull. Everything is in the space of the reference hull.
+====================================================
+*/
+int HullFaceContacts(const ShapeConvex* reference, const ShapeConvex* incident, const relativeTransform_t& refToInc, const relativeTransform_t& incToRef, const int referenceFaceIdx, Vec3* ptsOnReference, Vec3* ptsOnIncident, float* separations)
+{
+	const hullFace_t& referenceFace = reference->m_faces[referenceFaceIdx];
+	const Vec3& normal = referenceFace.normal;
+
+	// The incident face is the one most anti-parallel to the reference face
+	const Vec3 normalInIncident = refToInc.TransformVector(normal);
+	int incidentFaceIdx = 0;
+	float minDot = FLT_MAX;
+	for (int i = 0; i < incident->m_faces.size(); i++)
+	{
+		const float dot = incident->m_faces[i].normal.Dot(normalInIncident);
+		if (dot < minDot)
+		{
+			minDot = dot;
+			incidentFaceIdx = i;
+		}
+	}
+	const hullFace_t& incidentFace = incident->m_faces[incidentFaceIdx];
+
+	Vec3 points[MAX_HULL_CLIP_POINTS];
+	float depths[MAX_HULL_CLIP_POINTS];
+	int numPoints = 0;
+
+	if (incidentFace.numIndices + referenceFace.numIndices <= MAX_HULL_CLIP_POINTS)
+	{
+		Vec3 bufferA[MAX_HULL_CLIP_POINTS];
+		Vec3 bufferB[MAX_HULL_CLIP_POINTS];
+		Vec3* polygon = bufferA;
+		Vec3* clipped = bufferB;
+		int num = incidentFace.numIndices;
+		for (int i = 0; i < num; i++)
+		{
+			polygon[i] = incToRef.TransformPoint(incident->m_points[incident->m_faceIndices[incidentFace.firstIndex + i]]);
+		}
+
+		// The sides of a counter clockwise face point outwards when the edge is crossed with the normal
+		for (int i = 0; i < referenceFace.numIndices && num > 0; i++)
+		{
+			const Vec3& start = reference->m_points[reference->m_faceIndices[referenceFace.firstIndex + i]];
+			const Vec3& end = reference->m_points[reference->m_faceIndices[referenceFace.firstIndex + (i + 1) % referenceFace.numIndices]];
+			Vec3 sideNormal = (end - start).Cross(normal);
+			sideNormal.Normalize();
+
+			num = ClipPolygon(polygon, num, sideNormal, sideNormal.Dot(start), clipped);
+			std::swap(polygon, clipped);
+		}
+
+		// Only the points below the reference face are in contact
+		for (int i = 0; i < num; i++)
+		{
+			const float separation = normal.Dot(polygon[i]) - referenceFace.distance;
+			if (separation <= 0.0f)
+			{
+				points[numPoints] = polygon[i];
+				depths[numPoints] = -separation;
+				numPoints++;
+			}
+		}
+	}
+
+	if (numPoints == 0)
+	{
+		// Either there were too many points to clip, or the incident face of an irregular hull missed the reference
+		// face entirely. Fall back to the deepest point of the incident hull, which is below the reference face.
+		const Vec3 deepest = incToRef.TransformPoint(incident->m_points[incident->SupportIndex(normalInIncident * -1.0f, 0)]);
+		points[0] = deepest;
+		depths[0] = std::max(0.0f, referenceFace.distance - normal.Dot(deepest));
+		numPoints = 1;
+	}
+
+	int kept[MAX_REDUCED_CONTACTS];
+	const int numKept = ReduceContacts(points, depths, numPoints, normal, kept);
+	for (int i = 0; i < numKept; i++)
+	{
+		const Vec3& pt = points[kept[i]];
+		ptsOnIncident[i] = pt;
+		ptsOnReference[i] = pt + normal * depths[kept[i]];
+		separations[i] = -depths[kept[i]];
+	}
+	return numKept;
+}
+
+/*
+====================================================
+CachedFeatureSeparates
+
+Only touches the cached feature, and the support search of a face starts from last frame's support point
+====================================================
+*/
+bool CachedFeatureSeparates(const ShapeConvex* hullA, const ShapeConvex* hullB, const relativeTransform_t& aToB, const relativeTransform_t& bToA, satFeature_t& feature)
+{
+	switch (feature.type)
+	{
+	case SAT_FEATURE_FACE_A:
+		return FaceSeparation(hullA, hullB, aToB, bToA, feature.indexA, feature.supportIdxB) > 0.0f;
+	case SAT_FEATURE_FACE_B:
+		return FaceSeparation(hullB, hullA, bToA, aToB, feature.indexB, feature.supportIdxA) > 0.0f;
+	case SAT_FEATURE_EDGES:
+	{
+		// Only the two edges are needed, so they are moved into the space of A directly. The edges may have rotated
+		// so they no longer build a face of the Minkowski difference, and then their axis proves nothing.
+		const hullEdge_t& edgeA = hullA->m_edges[feature.indexA];
+		const hullEdge_t& edgeB = hullB->m_edges[feature.indexB];
+		const Vec3 c = bToA.TransformVector(hullB->m_faces[edgeB.faceA].normal) * -1.0f;
+		const Vec3 d = bToA.TransformVector(hullB->m_faces[edgeB.faceB].normal) * -1.0f;
+		if (!IsMinkowskiFace(hullA->m_faces[edgeA.faceA].normal, hullA->m_faces[edgeA.faceB].normal, c, d))
+		{
+			return false;
+		}
+
+		Vec3 axis;
+		return PairEdgeSeparation(hullA, hullB, bToA, feature.indexA, feature.indexB, axis) > 0.0f;
+	}
+	default:
+		return false;
+	}
+}
+
+/*
+====================================================
+HullHullContacts
+====================================================
+*/
+int HullHullContacts(Body* bodyA, Body* bodyB, narrowphaseCache_t* cache, contact_t* contacts)
+{
+	const ShapeConvex* hullA = reinterpret_cast<const ShapeConvex*>(bodyA->m_shape);
+	const ShapeConvex* hullB = reinterpret_cast<const ShapeConvex*>(bodyB->m_shape);
+
+	const relativeTransform_t aToB = RelativeTransform(bodyA, bodyB);
+	const relativeTransform_t bToA = RelativeTransform(bodyB, bodyA);
+
+	// Without a cache the queries write to a scratch feature that is dropped afterwards
+	satFeature_t scratch;
+	scratch.type = SAT_FEATURE_NONE;
+	scratch.indexA = -1;
+	scratch.indexB = -1;
+	scratch.supportIdxA = 0;
+	scratch.supportIdxB = 0;
+	satFeature_t& feature = (cache != nullptr) ? cache->separatingFeature : scratch;
+
+	// Separated bodies tend to stay separated by the same feature, so that is the only test on most frames
+	if (CachedFeatureSeparates(hullA, hullB, aToB, bToA, feature))
+	{
+		return 0;
+	}
+
+	float faceSeparationA;
+	int faceIdxA;
+	if (!QueryFaces(hullA, hullB, aToB, bToA, faceSeparationA, faceIdxA, feature.supportIdxB))
+	{
+		feature.type = SAT_FEATURE_FACE_A;
+		feature.indexA = faceIdxA;
+		feature.indexB = -1;
+		return 0;
+	}
+
+	float faceSeparationB;
+	int faceIdxB;
+	if (!QueryFaces(hullB, hullA, bToA, aToB, faceSeparationB, faceIdxB, feature.supportIdxA))
+	{
+		feature.type = SAT_FEATURE_FACE_B;
+		feature.indexA = -1;
+		feature.indexB = faceIdxB;
+		return 0;
+	}
+
+	MoveNormalsIntoSpace(hullB, bToA);
+	float edgeSeparation;
+	int edgeIdxA;
+	int edgeIdxB;
+	Vec3 edgeNormal;
+	if (!QueryEdges(hullA, hullB, bToA, edgeSeparation, edgeIdxA, edgeIdxB, edgeNormal))
+	{
+		feature.type = SAT_FEATURE_EDGES;
+		feature.indexA = edgeIdxA;
+		feature.indexB = edgeIdxB;
+		return 0;
+	}
+
+	feature.type = SAT_FEATURE_NONE;
+
+	// Prefer face contacts, an edge pair or a face of B has to be clearly better to be picked, so resting hulls
+	// don't flip between features
+	const Bounds boundsA = hullA->GetBounds();
+	const Bounds boundsB = hullB->GetBounds();
+	const float size = 0.5f * std::min(std::min(std::min(boundsA.WidthX(), boundsA.WidthY()), boundsA.WidthZ()),
+		std::min(std::min(boundsB.WidthX(), boundsB.WidthY()), boundsB.WidthZ()));
+
+	const bool useFaceB = IsFeatureClearlyBetter(faceSeparationB, faceSeparationA, size);
+	const float faceSeparation = useFaceB ? faceSeparationB : faceSeparationA;
+	const bool useEdges = (edgeIdxA != -1) && IsFeatureClearlyBetter(edgeSeparation, faceSeparation, size);
+
+	Vec3 ptsOnA[MAX_HULL_CONTACTS];
+	Vec3 ptsOnB[MAX_HULL_CONTACTS];
+	float separations[MAX_HULL_CONTACTS];
+	Vec3 normal;
+	int numContacts = 0;
+	if (useEdges)
+	{
+		const hullEdge_t& edgeA = hullA->m_edges[edgeIdxA];
+		const hullEdge_t& edgeB = hullB->m_edges[edgeIdxB];
+		Vec3 ptOnA;
+		Vec3 ptOnB;
+		ClosestPointsSegments(hullA->m_points[edgeA.a], hullA->m_points[edgeA.b], bToA.TransformPoint(hullB->m_points[edgeB.a]), bToA.TransformPoint(hullB->m_points[edgeB.b]), ptOnA, ptOnB);
+
+		ptsOnA[0] = bodyA->m_position + bodyA->m_orientation.RotatePoint(ptOnA);
+		ptsOnB[0] = bodyA->m_position + bodyA->m_orientation.RotatePoint(ptOnB);
+		separations[0] = edgeSeparation;
+		normal = bodyA->m_orientation.RotatePoint(edgeNormal);
+		numContacts = 1;
+	}
+	else if (useFaceB)
+	{
+		numContacts = HullFaceContacts(hullB, hullA, bToA, aToB, faceIdxB, ptsOnB, ptsOnA, separations);
+		for (int i = 0; i < numContacts; i++)
+		{
+			ptsOnA[i] = bodyB->m_position + bodyB->m_orientation.RotatePoint(ptsOnA[i]);
+			ptsOnB[i] = bodyB->m_position + bodyB->m_orientation.RotatePoint(ptsOnB[i]);
+		}
+		normal = bodyB->m_orientation.RotatePoint(hullB->m_faces[faceIdxB].normal) * -1.0f;
+	}
+	else
+	{
+		numContacts = HullFaceContacts(hullA, hullB, aToB, bToA, faceIdxA, ptsOnA, ptsOnB, separations);
+		for (int i = 0; i < numContacts; i++)
+		{
+			ptsOnA[i] = bodyA->m_position + bodyA->m_orientation.RotatePoint(ptsOnA[i]);
+			ptsOnB[i] = bodyA->m_position + bodyA->m_orientation.RotatePoint(ptsOnB[i]);
+		}
+		normal = bodyA->m_orientation.RotatePoint(hullA->m_faces[faceIdxA].normal);
+	}
+
+	for (int i = 0; i < numContacts; i++)
+	{
+		contact_t& contact = contacts[i];
+		contact.bodyA = bodyA;
+		contact.bodyB = bodyB;
+		contact.normal = normal;
+		contact.ptOnA_WorldSpace = ptsOnA[i];
+		contact.ptOnB_WorldSpace = ptsOnB[i];
+		contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(ptsOnA[i]);
+		contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(ptsOnB[i]);
+		contact.separationDistance = separations[i];
+		contact.timeOfImpact = 0.0f;
+	}
+	return numContacts;
+}
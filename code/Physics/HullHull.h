@@ -0,0 +1,23 @@
+//
+//	HullHull.h
+//
+#pragma once
+#include "Contact.h"
+#include "ContactClipping.h"
+#include "NarrowphaseCache.h"
+
+static const int MAX_HULL_CONTACTS = MAX_REDUCED_CONTACTS;
+
+/*
+====================================================
+HullHullContacts
+
+Separating axis test between two convex hulls using the faces and edges built with the hulls. Edge pairs are only
+tested when their arcs on the Gauss maps cross, which is when they form a face of the Minkowski difference.
+
+When a cache is given, the feature that separated the hulls last time is tested first, and if it still separates
+them the test ends there. The support searches of the face queries walk the hulls from the points found last time. When the hulls overlap, the incident face is clipped against the reference face like the
+box test, which gives up to 4 contacts. Returns the number of contacts written, 0 when the hulls are separated.
+====================================================
+*/
+int HullHullContacts(Body* bodyA, Body* bodyB, narrowphaseCache_t* cache, contact_t* contacts);
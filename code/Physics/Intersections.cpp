@@ -3,6 +3,10 @@
 //
 #include "Intersections.h"
 #include "GJK.h"
+#include "BoxBox.h"
+#include "HullHull.h"
+#include <algorithm>
+#include <float.h>
 
 bool RaySphere(const Vec3& rayStart, const Vec3& rayDirection, const Vec3& sphereCenter, const float sphereRadius, float& t1, float& t2)
 {
@@ -82,97 +86,641 @@ bool SphereSphereDynamic(const ShapeSphere* shapeA, const ShapeSphere* shapeB, c
 	return true;
 }
 
+// Fills the contact for a sphere and another body at their current positions, the separation is positive while
+// they are apart
+typedef void (*sphereContactFunc_t)(Body* sphereBody, Body* body, narrowphaseCache_t* cache, contact_t& contact);
+
+void SetSphereContact(Body* sphereBody, Body* body, const Vec3& ptOnBody, const Vec3& normal, const float distance, contact_t& contact)
+{
+	const ShapeSphere* sphere = reinterpret_cast<const ShapeSphere*>(sphereBody->m_shape);
+
+	contact.bodyA = sphereBody;
+	contact.bodyB = body;
+	contact.normal = normal;
+	contact.ptOnA_WorldSpace = sphereBody->m_position + normal * sphere->m_radius;
+	contact.ptOnB_WorldSpace = ptOnBody;
+	contact.separationDistance = distance - sphere->m_radius;
+}
+
+/*
+====================================================
+SphereBoxContact
+
+The closest point is found by clamping the center to the box in the local space of the box. A center inside the
+box is pushed out through the nearest face.
+====================================================
+*/
+void SphereBoxContact(Body* sphereBody, Body* boxBody, narrowphaseCache_t* /*cache*/, contact_t& contact)
+{
+	const ShapeBox* box = reinterpret_cast<const ShapeBox*>(boxBody->m_shape);
+	const Bounds& bounds = box->m_bounds;
+	const Vec3 center = boxBody->m_orientation.Inverse().RotatePoint(sphereBody->m_position - boxBody->m_position);
+
+	Vec3 closest;
+	bool isInside = true;
+	for (int i = 0; i < 3; i++)
+	{
+		closest[i] = std::max(bounds.mins[i], std::min(bounds.maxs[i], center[i]));
+		if (closest[i] != center[i])
+		{
+			isInside = false;
+		}
+	}
+
+	Vec3 normal;
+	float distance;
+	if (!isInside)
+	{
+		normal = closest - center;
+		distance = normal.GetMagnitude();
+		normal /= distance;
+	}
+	else
+	{
+		int axis = 0;
+		float side = 1.0f;
+		distance = -FLT_MAX;
+		for (int i = 0; i < 3; i++)
+		{
+			const float toMins = bounds.mins[i] - center[i];
+			const float toMaxs = center[i] - bounds.maxs[i];
+			if (toMins > distance)
+			{
+				distance = toMins;
+				axis = i;
+				side = -1.0f;
+			}
+			if (toMaxs > distance)
+			{
+				distance = toMaxs;
+				axis = i;
+				side = 1.0f;
+			}
+		}
+
+		// The face normal points out of the box, towards the center of the sphere
+		closest[axis] = (side > 0.0f) ? bounds.maxs[axis] : bounds.mins[axis];
+		normal.Zero();
+		normal[axis] = -side;
+	}
+
+	const Vec3 ptOnBox = boxBody->m_position + boxBody->m_orientation.RotatePoint(closest);
+	SetSphereContact(sphereBody, boxBody, ptOnBox, boxBody->m_orientation.RotatePoint(normal), distance, contact);
+}
+
+/*
+====================================================
+SphereConvexContact
+
+GJK only has to find the closest point of the hull to the center of the sphere, the radius is added afterwards.
+A center inside the hull is pushed out through the nearest face.
+====================================================
+*/
+void SphereConvexContact(Body* sphereBody, Body* hullBody, narrowphaseCache_t* cache, contact_t& contact)
+{
+	const Vec3& center = sphereBody->m_position;
+
+	Vec3 ptOnHull;
+	if (GJK_ClosestPoint(hullBody, center, ptOnHull, (cache != nullptr) ? &cache->gjk : nullptr))
+	{
+		Vec3 normal = ptOnHull - center;
+		const float distance = normal.GetMagnitude();
+		if (distance > 0.0f)
+		{
+			normal /= distance;
+			SetSphereContact(sphereBody, hullBody, ptOnHull, normal, distance, contact);
+			return;
+		}
+	}
+
+	const ShapeConvex* hull = reinterpret_cast<const ShapeConvex*>(hullBody->m_shape);
+	const Vec3 localCenter = hullBody->m_orientation.Inverse().RotatePoint(center - hullBody->m_position);
+
+	int nearestFace = 0;
+	float distance = -FLT_MAX;
+	for (int i = 0; i < hull->m_faces.size(); i++)
+	{
+		const float faceDistance = hull->m_faces[i].normal.Dot(localCenter) - hull->m_faces[i].distance;
+		if (faceDistance > distance)
+		{
+			distance = faceDistance;
+			nearestFace = i;
+		}
+	}
+
+	const Vec3& faceNormal = hull->m_faces[nearestFace].normal;
+	ptOnHull = hullBody->m_position + hullBody->m_orientation.RotatePoint(localCenter - faceNormal * distance);
+	SetSphereContact(sphereBody, hullBody, ptOnHull, hullBody->m_orientation.RotatePoint(faceNormal) * -1.0f, distance, contact);
+}
+
+/*
+====================================================
+SphereShapeDynamic
+
+Conservative advancement, the bodies are moved forward by the time it takes to close the gap between them at the
+fastest speed they can approach each other, until they touch or run out of time
+====================================================
+*/
+bool SphereShapeDynamic(Body* sphereBody, Body* body, const float dt, narrowphaseCache_t* cache, contact_t& contact, sphereContactFunc_t contactFunc)
+{
+	const int maxIterations = 10;
+	const bool isContinuous = sphereBody->m_useCCD || body->m_useCCD;
+
+	// The copies are advanced instead of the bodies, which stay as they are for the rest of the narrowphase
+	Body sphereAtToi = sphereBody->Predicted(0.0f);
+	Body bodyAtToi = body->Predicted(0.0f);
+
+	float toi = 0.0f;
+	bool didTouch = false;
+	for (int numIters = 0; numIters < maxIterations; numIters++)
+	{
+		contactFunc(&sphereAtToi, &bodyAtToi, cache, contact);
+		if (contact.separationDistance <= CONTACT_TOUCHING_DISTANCE)
+		{
+			didTouch = true;
+			break;
+		}
+
+		// Slow pairs are only tested where the bodies are
+		if (!isContinuous)
+		{
+			break;
+		}
+
+		// The rotation of the sphere doesn't move its surface towards the other body
+		const Vec3 relativeVelocity = sphereAtToi.m_linearVelocity - bodyAtToi.m_linearVelocity;
+		const float closingSpeed = relativeVelocity.Dot(contact.normal) + bodyAtToi.m_shape->FastestLinearSpeed(bodyAtToi.m_angularVelocity, contact.normal * -1.0f);
+		if (closingSpeed <= 0.0f)
+		{
+			break;
+		}
+
+		const float timeToGo = contact.separationDistance / closingSpeed;
+		if (toi + timeToGo > dt)
+		{
+			break;
+		}
+
+		toi += timeToGo;
+		sphereAtToi = sphereBody->Predicted(toi);
+		bodyAtToi = body->Predicted(toi);
+	}
+
+	contact.bodyA = sphereBody;
+	contact.bodyB = body;
+	if (didTouch)
+	{
+		// Convert world space contact points to local space
+		contact.ptOnA_LocalSpace = sphereAtToi.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+		contact.ptOnB_LocalSpace = bodyAtToi.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+		contact.timeOfImpact = toi;
+	}
+	return didTouch;
+}
+
 /*
 ====================================================
 Intersect
 ====================================================
 */
 bool Intersect(Body* bodyA, Body* bodyB, contact_t& contact)
+{
+	// Without a time step there is nothing to sweep, the routines only test where the bodies are
+	return Intersect(bodyA, bodyB, 0.0f, contact, nullptr);
+}
+
+/*
+====================================================
+IntersectSphereSphere
+====================================================
+*/
+bool IntersectSphereSphere(Body* bodyA, Body* bodyB, const float dt, contact_t& contact, narrowphaseCache_t* /*cache*/)
 {
 	contact.bodyA = bodyA;
 	contact.bodyB = bodyB;
 
-	const Vec3 dist = bodyB->m_position - bodyA->m_position;
-	contact.normal = dist;
-	contact.normal.Normalize();
+	const ShapeSphere* sphereA = reinterpret_cast<const ShapeSphere*>(bodyA->m_shape);
+	const ShapeSphere* sphereB = reinterpret_cast<const ShapeSphere*>(bodyB->m_shape);
 
-	const auto sphereA = reinterpret_cast<const ShapeSphere*>(bodyA->m_shape);
-	const auto sphereB = reinterpret_cast<const ShapeSphere*>(bodyB->m_shape);
+	const Vec3 positionA = bodyA->m_position;
+	const Vec3 positionB = bodyB->m_position;
 
-	contact.ptOnA_WorldSpace = bodyA->m_position + contact.normal * sphereA->m_radius;
-	contact.ptOnB_WorldSpace = bodyB->m_position - contact.normal * sphereB->m_radius;
+	const Vec3 velocityA = bodyA->m_linearVelocity;
+	const Vec3 velocityB = bodyB->m_linearVelocity;
 
-	const float totalRadii = sphereA->m_radius + sphereB->m_radius;
-	return dist.GetLengthSqr() <= (totalRadii * totalRadii);
+	// Without a sweep the test only looks at where the spheres are
+	const float sweepTime = (bodyA->m_useCCD || bodyB->m_useCCD) ? dt : 0.0f;
+
+	if (SphereSphereDynamic(sphereA, sphereB, positionA, positionB, velocityA, velocityB, sweepTime, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace, contact.timeOfImpact))
+	{
+		// Predict the bodies at the time of impact to get local space collision points
+		const Body bodyAtToiA = bodyA->Predicted(contact.timeOfImpact);
+		const Body bodyAtToiB = bodyB->Predicted(contact.timeOfImpact);
+
+		// Convert world space contact points to local space
+		contact.ptOnA_LocalSpace = bodyAtToiA.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+		contact.ptOnB_LocalSpace = bodyAtToiB.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+
+		contact.normal = bodyAtToiB.m_position - bodyAtToiA.m_position;
+		contact.normal.Normalize();
+
+		// Calculate the separation distance
+		Vec3 ab = bodyB->m_position - bodyA->m_position;
+		contact.separationDistance = ab.GetMagnitude() - (sphereA->m_radius + sphereB->m_radius);
+		return true;
+	}
+
+	return false;
 }
 
 /*
 ====================================================
-Intersect
+IntersectSphereBox
+====================================================
+*/
+bool IntersectSphereBox(Body* bodyA, Body* bodyB, const float dt, contact_t& contact, narrowphaseCache_t* cache)
+{
+	return SphereShapeDynamic(bodyA, bodyB, dt, cache, contact, SphereBoxContact);
+}
+
+/*
+====================================================
+IntersectSphereConvex
 ====================================================
 */
-bool Intersect(Body* bodyA, Body* bodyB, const float dt, contact_t& contact)
+bool IntersectSphereConvex(Body* bodyA, Body* bodyB, const float dt, contact_t& contact, narrowphaseCache_t* cache)
 {
-	if (bodyA->m_shape->GetType() == Shape::SHAPE_SPHERE && bodyB->m_shape->GetType() == Shape::SHAPE_SPHERE)
+	return SphereShapeDynamic(bodyA, bodyB, dt, cache, contact, SphereConvexContact);
+}
+
+/*
+====================================================
+IntersectBoxBox
+
+The TOI loop resolves a single contact per pair, so only the deepest of the box contacts is reported
+====================================================
+*/
+bool IntersectBoxBox(Body* bodyA, Body* bodyB, const float /*dt*/, contact_t& contact, narrowphaseCache_t* /*cache*/)
+{
+	contact_t contacts[MAX_BOX_CONTACTS];
+	const int numContacts = BoxBoxContacts(bodyA, bodyB, contacts);
+	if (numContacts == 0)
 	{
-		contact.bodyA = bodyA;
-		contact.bodyB = bodyB;
+		return false;
+	}
 
-		const ShapeSphere* sphereA = reinterpret_cast<const ShapeSphere*>(bodyA->m_shape);
-		const ShapeSphere* sphereB = reinterpret_cast<const ShapeSphere*>(bodyB->m_shape);
+	int deepest = 0;
+	for (int i = 1; i < numContacts; i++)
+	{
+		if (contacts[i].separationDistance < contacts[deepest].separationDistance)
+		{
+			deepest = i;
+		}
+	}
+	contact = contacts[deepest];
+	return true;
+}
 
-		const Vec3 positionA = bodyA->m_position;
-		const Vec3 positionB = bodyB->m_position;
+/*
+====================================================
+IntersectHullHull
 
-		const Vec3 velocityA = bodyA->m_linearVelocity;
-		const Vec3 velocityB = bodyB->m_linearVelocity;
+Reports the deepest of the hull contacts, like the box test
+====================================================
+*/
+bool IntersectHullHull(Body* bodyA, Body* bodyB, const float /*dt*/, contact_t& contact, narrowphaseCache_t* cache)
+{
+	contact_t contacts[MAX_HULL_CONTACTS];
+	const int numContacts = HullHullContacts(bodyA, bodyB, cache, contacts);
+	if (numContacts == 0)
+	{
+		return false;
+	}
 
-		if (SphereSphereDynamic(sphereA, sphereB, positionA, positionB, velocityA, velocityB, dt, contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace, contact.timeOfImpact))
+	int deepest = 0;
+	for (int i = 1; i < numContacts; i++)
+	{
+		if (contacts[i].separationDistance < contacts[deepest].separationDistance)
 		{
-			// Step bodies forward to get local space collision points
-			bodyA->Update(contact.timeOfImpact);
-			bodyB->Update(contact.timeOfImpact);
+			deepest = i;
+		}
+	}
+	contact = contacts[deepest];
+	return true;
+}
+
+/*
+====================================================
+SetPenetrationContact
+====================================================
+*/
+void SetPenetrationContact(Body* bodyA, Body* bodyB, const Vec3& normal, const Vec3& ptOnA, const Vec3& ptOnB, contact_t& contact)
+{
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+	contact.normal = normal;
+	contact.ptOnA_WorldSpace = ptOnA;
+	contact.ptOnB_WorldSpace = ptOnB;
+	contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(ptOnA);
+	contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(ptOnB);
+	contact.separationDistance = (ptOnB - ptOnA).Dot(normal);
+	contact.timeOfImpact = 0.0f;
+}
+
+/*
+====================================================
+CoreContact
+
+Shapes whose cores are apart get their contact from the closest points of the cores pushed out by the convex radii,
+returns false when the cores overlap and the penetration has to come from the full shapes
+====================================================
+*/
+bool CoreContact(Body* bodyA, Body* bodyB, gjkCache_t* gjkCache, contact_t& contact)
+{
+	Vec3 coreA;
+	Vec3 coreB;
+	if (!GJK_ClosestCorePoints(bodyA, bodyB, coreA, coreB, gjkCache))
+	{
+		return false;
+	}
+
+	Vec3 normal = coreB - coreA;
+	const float distance = normal.GetMagnitude();
+	if (distance < 1e-6f)
+	{
+		return false;
+	}
+	normal /= distance;
 
-			// Convert world space contact points to local space
-			contact.ptOnA_LocalSpace = bodyA->WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
-			contact.ptOnB_LocalSpace = bodyB->WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	const Vec3 ptOnA = coreA + normal * bodyA->m_shape->GetConvexRadius();
+	const Vec3 ptOnB = coreB - normal * bodyB->m_shape->GetConvexRadius();
+	SetPenetrationContact(bodyA, bodyB, normal, ptOnA, ptOnB, contact);
+	return true;
+}
 
-			contact.normal = bodyB->m_position - bodyA->m_position;
-			contact.normal.Normalize();
+/*
+====================================================
+DeepContact
 
-			// Unwind time step
-			bodyA->Update(-contact.timeOfImpact);
-			bodyB->Update(-contact.timeOfImpact);
+Contact of shapes that overlap deeper than their convex radii, from GJK and EPA
+====================================================
+*/
+static bool DeepContact(Body* bodyA, Body* bodyB, contact_t& contact)
+{
+	const float bias = 0.001f;
 
-			// Calculate the separation distance
-			Vec3 ab = bodyB->m_position - bodyA->m_position;
-			contact.separationDistance = ab.GetMagnitude() - (sphereA->m_radius + sphereB->m_radius);
-			return true;
-		}
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+	if (!GJK_DoesIntersect(bodyA, bodyB, bias, ptOnA, ptOnB))
+	{
+		return false;
+	}
+
+	// The points cross over while the bodies overlap, so A to B is from the point on B to the point on A
+	Vec3 normal = ptOnA - ptOnB;
+	const float lengthSqr = normal.GetLengthSqr();
+	if (lengthSqr < 1e-12f)
+	{
+		// Only touching, there is no normal to push along
+		return false;
 	}
+	normal /= sqrtf(lengthSqr);
 
+	// The points are on the shapes grown by the bias, move them back onto the surfaces
+	ptOnA -= normal * bias;
+	ptOnB += normal * bias;
 
-	return false;
+	SetPenetrationContact(bodyA, bodyB, normal, ptOnA, ptOnB, contact);
+	return contact.separationDistance <= 0.0f;
 }
 
+/*
+====================================================
+IntersectGeneric
 
+Used for the shape pairs that have no specialized routine. EPA only runs when the penetration is deeper than the
+convex radii. Only tests the bodies where they are, there is no sweep for these pairs.
+====================================================
+*/
+bool IntersectGeneric(Body* bodyA, Body* bodyB, const float /*dt*/, contact_t& contact, narrowphaseCache_t* cache)
+{
+	if (CoreContact(bodyA, bodyB, (cache != nullptr) ? &cache->gjk : nullptr, contact))
+	{
+		return contact.separationDistance <= 0.0f;
+	}
+	return DeepContact(bodyA, bodyB, contact);
+}
 
+/*
+====================================================
+IntersectMPR
 
+Same as the generic routine with MPR in place of GJK and EPA for the deep penetrations. The cores overlap by then,
+so MPR failing means it gave up rather than that the shapes are apart, and GJK and EPA take over.
+====================================================
+*/
+bool IntersectMPR(Body* bodyA, Body* bodyB, const float /*dt*/, contact_t& contact, narrowphaseCache_t* cache)
+{
+	if (CoreContact(bodyA, bodyB, (cache != nullptr) ? &cache->gjk : nullptr, contact))
+	{
+		return contact.separationDistance <= 0.0f;
+	}
 
+	Vec3 normal;
+	float depth;
+	Vec3 ptOnA;
+	Vec3 ptOnB;
+	if (!MPR_Penetration(bodyA, bodyB, normal, depth, ptOnA, ptOnB))
+	{
+		return DeepContact(bodyA, bodyB, contact);
+	}
 
+	SetPenetrationContact(bodyA, bodyB, normal, ptOnA, ptOnB, contact);
+	return true;
+}
 
+struct intersectEntry_t
+{
+	intersectFunc_t func;
+	bool swapBodies;	// The routine was registered for the opposite order of shape types
+};
 
+/*
+====================================================
+intersectTable_t
 
+Every cell starts out with the generic routine, the specialized ones are registered on first use
+====================================================
+*/
+struct intersectTable_t
+{
+	intersectEntry_t entries[Shape::NUM_SHAPE_TYPES][Shape::NUM_SHAPE_TYPES];
 
+	intersectTable_t()
+	{
+		for (int a = 0; a < Shape::NUM_SHAPE_TYPES; a++)
+		{
+			for (int b = 0; b < Shape::NUM_SHAPE_TYPES; b++)
+			{
+				entries[a][b].func = IntersectGeneric;
+				entries[a][b].swapBodies = false;
+			}
+		}
 
+		Register(Shape::SHAPE_SPHERE, Shape::SHAPE_SPHERE, IntersectSphereSphere);
+		Register(Shape::SHAPE_SPHERE, Shape::SHAPE_BOX, IntersectSphereBox);
+		Register(Shape::SHAPE_SPHERE, Shape::SHAPE_CONVEX, IntersectSphereConvex);
+		Register(Shape::SHAPE_BOX, Shape::SHAPE_BOX, IntersectBoxBox);
+		Register(Shape::SHAPE_CONVEX, Shape::SHAPE_CONVEX, IntersectHullHull);
+	}
+
+	void Register(const Shape::shapeType_t typeA, const Shape::shapeType_t typeB, intersectFunc_t func)
+	{
+		entries[typeA][typeB].func = func;
+		entries[typeA][typeB].swapBodies = false;
+		if (typeA != typeB)
+		{
+			entries[typeB][typeA].func = func;
+			entries[typeB][typeA].swapBodies = true;
+		}
+	}
+};
 
+static intersectTable_t& GetIntersectTable()
+{
+	static intersectTable_t table;
+	return table;
+}
 
+/*
+====================================================
+RegisterIntersect
+====================================================
+*/
+void RegisterIntersect(const Shape::shapeType_t typeA, const Shape::shapeType_t typeB, intersectFunc_t func)
+{
+	GetIntersectTable().Register(typeA, typeB, func);
+}
 
+/*
+====================================================
+SweptContact
 
+Conservative advancement for the routines that only test the bodies where they are. Copies of the bodies are moved
+forward by the time it takes to close the gap between them at the fastest speed they can approach each other, until
+they touch, then the routine gives the contact where the copies are. If the routine finds nothing, the closest
+points are only taken as the contact when they are within touching distance. Copies that are still apart when the
+iterations run out report nothing, an impulse between bodies that haven't met would bounce them off thin air.
+====================================================
+*/
+static bool SweptContact(Body* bodyA, Body* bodyB, const float dt, contact_t& contact, narrowphaseCache_t* cache, intersectFunc_t func)
+{
+	const int maxIterations = 10;
 
+	Body bodyAtToiA = bodyA->Predicted(0.0f);
+	Body bodyAtToiB = bodyB->Predicted(0.0f);
 
+	// The copies barely move between iterations, so each query starts from the simplex of the one before
+	gjkCache_t gjkCache;
+	gjkCache.Clear();
 
+	float toi = 0.0f;
+	bool isApart = CoreContact(&bodyAtToiA, &bodyAtToiB, &gjkCache, contact);
+	for (int numIters = 0; numIters < maxIterations && isApart && contact.separationDistance > CONTACT_TOUCHING_DISTANCE; numIters++)
+	{
+		const Vec3 relativeVelocity = bodyAtToiA.m_linearVelocity - bodyAtToiB.m_linearVelocity;
+		const float closingSpeed = relativeVelocity.Dot(contact.normal)
+			+ bodyAtToiA.m_shape->FastestLinearSpeed(bodyAtToiA.m_angularVelocity, contact.normal)
+			+ bodyAtToiB.m_shape->FastestLinearSpeed(bodyAtToiB.m_angularVelocity, contact.normal * -1.0f);
+		if (closingSpeed <= 0.0f)
+		{
+			return false;
+		}
 
+		const float timeToGo = contact.separationDistance / closingSpeed;
+		if (toi + timeToGo > dt)
+		{
+			return false;
+		}
 
+		toi += timeToGo;
+		bodyAtToiA = bodyA->Predicted(toi);
+		bodyAtToiB = bodyB->Predicted(toi);
+		isApart = CoreContact(&bodyAtToiA, &bodyAtToiB, &gjkCache, contact);
+	}
 
+	const contact_t closestContact = contact;
+	if (!func(&bodyAtToiA, &bodyAtToiB, 0.0f, contact, cache))
+	{
+		if (!isApart || closestContact.separationDistance > CONTACT_TOUCHING_DISTANCE)
+		{
+			return false;
+		}
+		contact = closestContact;
+	}
 
+	contact.bodyA = bodyA;
+	contact.bodyB = bodyB;
+	contact.ptOnA_LocalSpace = bodyAtToiA.WorldSpaceToBodySpace(contact.ptOnA_WorldSpace);
+	contact.ptOnB_LocalSpace = bodyAtToiB.WorldSpaceToBodySpace(contact.ptOnB_WorldSpace);
+	contact.timeOfImpact = toi;
+	return true;
+}
+
+/*
+====================================================
+Intersect
+
+The sphere routines sweep the pairs that need it on their own, the pairs of other shapes are swept here
+====================================================
+*/
+bool Intersect(Body* bodyA, Body* bodyB, const float dt, contact_t& contact, narrowphaseCache_t* cache)
+{
+	const intersectEntry_t& entry = GetIntersectTable().entries[bodyA->m_shape->GetType()][bodyB->m_shape->GetType()];
+	Body* routineA = entry.swapBodies ? bodyB : bodyA;
+	Body* routineB = entry.swapBodies ? bodyA : bodyB;
+
+	const bool hasSphere = bodyA->m_shape->GetType() == Shape::SHAPE_SPHERE || bodyB->m_shape->GetType() == Shape::SHAPE_SPHERE;
+	const bool needsSweep = dt > 0.0f && !hasSphere && (bodyA->m_useCCD || bodyB->m_useCCD);
+	const bool hasContact = needsSweep
+		? SweptContact(routineA, routineB, dt, contact, cache, entry.func)
+		: entry.func(routineA, routineB, dt, contact, cache);
+	if (!hasContact)
+	{
+		return false;
+	}
+	if (!entry.swapBodies)
+	{
+		return true;
+	}
+
+	// Put the contact back in the order of the caller
+	std::swap(contact.bodyA, contact.bodyB);
+	std::swap(contact.ptOnA_WorldSpace, contact.ptOnB_WorldSpace);
+	std::swap(contact.ptOnA_LocalSpace, contact.ptOnB_LocalSpace);
+	contact.normal *= -1.0f;
+	return true;
+}
+
+/*
+====================================================
+SpeculativeContact
+
+The gap of pairs that are apart comes from their cores, it is kept when the bodies approach fast enough to close it
+within the step. The rotation of either body may move its surface towards the other one as well.
+====================================================
+*/
+bool SpeculativeContact(Body* bodyA, Body* bodyB, const float dt, contact_t& contact, narrowphaseCache_t* cache)
+{
+	if (CoreContact(bodyA, bodyB, (cache != nullptr) ? &cache->speculative : nullptr, contact) && contact.separationDistance > 0.0f)
+	{
+		const Vec3 relativeVelocity = bodyA->m_linearVelocity - bodyB->m_linearVelocity;
+		const float closingSpeed = relativeVelocity.Dot(contact.normal)
+			+ bodyA->m_shape->FastestLinearSpeed(bodyA->m_angularVelocity, contact.normal)
+			+ bodyB->m_shape->FastestLinearSpeed(bodyB->m_angularVelocity, contact.normal * -1.0f);
+		return contact.separationDistance <= closingSpeed * dt;
+	}
+
+	// Already touching, so there is no time of impact to look for
+	return Intersect(bodyA, bodyB, 0.0f, contact, cache);
+}
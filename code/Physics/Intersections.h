@@ -3,6 +3,25 @@
 //
 #pragma once
 #include "Contact.h"
+#include "NarrowphaseCache.h"
 
 bool Intersect( Body * bodyA, Body * bodyB, contact_t & contact );
-bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact );
\ No newline at end of file
+bool Intersect( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, narrowphaseCache_t * cache = nullptr );
+
+// Narrowphase routine for one pair of shape types, bodyA always has the first type the routine was registered with.
+// The cache holds what the routine kept for this pair last step, it is null when the caller doesn't track pairs.
+typedef bool ( *intersectFunc_t )( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, narrowphaseCache_t * cache );
+
+// Makes Intersect use func for this pair of shape types. The swapped order is covered as well, the bodies are
+// passed in the registered order and the contact is flipped back. The narrowphase runs pairs on several threads at
+// once, so a routine must not change the bodies, it steps copies of them to look ahead in time.
+void RegisterIntersect( const Shape::shapeType_t typeA, const Shape::shapeType_t typeB, intersectFunc_t func );
+
+// The routines for pairs without a specialized one, IntersectGeneric finds the penetration with GJK and EPA and
+// IntersectMPR with MPR. Every such pair starts out with IntersectGeneric, register IntersectMPR to switch a pair.
+bool IntersectGeneric( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, narrowphaseCache_t * cache );
+bool IntersectMPR( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, narrowphaseCache_t * cache );
+
+// Contact of the pair at the current time for the speculative solver. Pairs that are apart are reported as well when
+// they can close the gap within dt, their separation stays positive. Touching pairs get the contact of their routine.
+bool SpeculativeContact( Body * bodyA, Body * bodyB, const float dt, contact_t & contact, narrowphaseCache_t * cache );
@@ -0,0 +1,51 @@
+//
+//	NarrowphaseCache.h
+//
+#pragma once
+#include "GJK.h"
+
+enum satFeatureType_t
+{
+	SAT_FEATURE_NONE,
+	SAT_FEATURE_FACE_A,
+	SAT_FEATURE_FACE_B,
+	SAT_FEATURE_EDGES,
+};
+
+// Face or edge pair whose axis separated the shapes the last time they were tested
+struct satFeature_t
+{
+	satFeatureType_t type;
+	int indexA;
+	int indexB;
+
+	// Support points found by the last face queries, where the next walk over the other hull starts
+	int supportIdxA;
+	int supportIdxB;
+};
+
+/*
+====================================================
+narrowphaseCache_t
+
+State the narrowphase keeps for one broadphase pair between steps. The scene stores one per pair id of the pair
+cache and clears it when the pair starts overlapping.
+====================================================
+*/
+struct narrowphaseCache_t
+{
+	satFeature_t separatingFeature;
+	gjkCache_t gjk;
+	gjkCache_t speculative;	// Core simplex of the speculative distance query, kept apart from what the routines cache
+
+	void Clear()
+	{
+		gjk.Clear();
+		speculative.Clear();
+		separatingFeature.type = SAT_FEATURE_NONE;
+		separatingFeature.indexA = -1;
+		separatingFeature.indexB = -1;
+		separatingFeature.supportIdxA = 0;
+		separatingFeature.supportIdxB = 0;
+	}
+};
@@ -0,0 +1,99 @@
+//
+//  PairCache.cpp
+//
+#include "PairCache.h"
+#include <algorithm>
+
+/*
+====================================================
+PairCache::Clear
+====================================================
+*/
+void PairCache::Clear()
+{
+	m_pairs.clear();
+	m_previousPairs.clear();
+	m_newPairs.clear();
+	m_persistingPairs.clear();
+	m_endedPairs.clear();
+	m_freeIds.clear();
+	m_numIds = 0;
+}
+
+/*
+====================================================
+PairCache::AllocateId
+====================================================
+*/
+int PairCache::AllocateId()
+{
+	if (m_freeIds.empty())
+	{
+		return m_numIds++;
+	}
+
+	const int id = m_freeIds.back();
+	m_freeIds.pop_back();
+	return id;
+}
+
+/*
+====================================================
+PairCache::Update
+====================================================
+*/
+void PairCache::Update(const std::vector<collisionPair_t>& collisionPairs)
+{
+	m_previousPairs.swap(m_pairs);
+	m_pairs.resize(collisionPairs.size());
+	for (int i = 0; i < (int)collisionPairs.size(); i++)
+	{
+		const collisionPair_t& pair = collisionPairs[i];
+		cachedPair_t& cached = m_pairs[i];
+		cached.a = std::min(pair.a, pair.b);
+		cached.b = std::max(pair.a, pair.b);
+		cached.id = -1;
+	}
+	std::sort(m_pairs.begin(), m_pairs.end(), [](const cachedPair_t& lhs, const cachedPair_t& rhs) {
+		return lhs.GetKey() < rhs.GetKey();
+	});
+
+	m_newPairs.clear();
+	m_persistingPairs.clear();
+	m_endedPairs.clear();
+
+	// Both lists are sorted, so a single merge pass matches the pairs that were already overlapping
+	int prev = 0;
+	const int numPrevious = (int)m_previousPairs.size();
+	for (cachedPair_t& pair : m_pairs)
+	{
+		const uint64_t key = pair.GetKey();
+		while (prev < numPrevious && m_previousPairs[prev].GetKey() < key)
+		{
+			m_endedPairs.push_back(m_previousPairs[prev]);
+			prev++;
+		}
+
+		if (prev < numPrevious && m_previousPairs[prev].GetKey() == key)
+		{
+			pair.id = m_previousPairs[prev].id;
+			m_persistingPairs.push_back(pair);
+			prev++;
+		}
+		else
+		{
+			pair.id = AllocateId();
+			m_newPairs.push_back(pair);
+		}
+	}
+	for (; prev < numPrevious; prev++)
+	{
+		m_endedPairs.push_back(m_previousPairs[prev]);
+	}
+
+	// Ids of the ended pairs are only recycled now, so a new pair never shares an id with one that ended this step
+	for (const cachedPair_t& pair : m_endedPairs)
+	{
+		m_freeIds.push_back(pair.id);
+	}
+}
@@ -0,0 +1,59 @@
+//
+//	PairCache.h
+//
+#pragma once
+#include "CollisionPair.h"
+#include <vector>
+#include <stdint.h>
+
+struct cachedPair_t
+{
+	int a;	// Always the lower body index
+	int b;
+	int id;	// Stays the same for as long as the pair keeps overlapping
+
+	uint64_t GetKey() const { return ((uint64_t)a << 32) | (uint64_t)(uint32_t)b; }
+};
+
+/*
+====================================================
+PairCache
+
+Remembers the broadphase pairs of the previous step, so every overlapping pair keeps the same id across frames.
+Ids are recycled once a pair ends, so they stay small enough to index per pair arrays directly. After each Update
+the pairs are split into the ones that started, the ones that kept overlapping and the ones that ended this step.
+====================================================
+*/
+class PairCache
+{
+public:
+	PairCache() : m_numIds(0) {}
+
+	void Clear();
+
+	// The pairs must be unique, they do not need to be sorted and may have a and b in any order
+	void Update(const std::vector<collisionPair_t>& collisionPairs);
+
+	// All the pairs of the last update sorted by body indices, along with their ids
+	const std::vector<cachedPair_t>& GetPairs() const { return m_pairs; }
+
+	const std::vector<cachedPair_t>& GetNewPairs() const { return m_newPairs; }
+	const std::vector<cachedPair_t>& GetPersistingPairs() const { return m_persistingPairs; }
+	const std::vector<cachedPair_t>& GetEndedPairs() const { return m_endedPairs; }
+
+	// Every id handed out so far is below this, arrays indexed by pair id need this many entries
+	int GetIdCapacity() const { return m_numIds; }
+
+private:
+	int AllocateId();
+
+	std::vector<cachedPair_t> m_pairs;
+	std::vector<cachedPair_t> m_previousPairs;
+
+	std::vector<cachedPair_t> m_newPairs;
+	std::vector<cachedPair_t> m_persistingPairs;
+	std::vector<cachedPair_t> m_endedPairs;
+
+	std::vector<int> m_freeIds;
+	int m_numIds;
+};
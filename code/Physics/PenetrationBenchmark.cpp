@@ -0,0 +1,164 @@
+//
+//	PenetrationBenchmark.cpp
+//
+#include "PenetrationBenchmark.h"
+#include "GJK.h"
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <stdio.h>
+
+// Writing the results out keeps the compiler from dropping the queries
+static volatile float s_sink = 0.0f;
+
+/*
+================================
+BenchmarkPenetration
+
+Every pair of shapes is pushed together along random directions past the point where they touch, once by a little
+like a resting contact and once deep.
+================================
+*/
+void BenchmarkPenetration() {
+	const int numPlacements = 1000;
+	const int numRepeats = 20;
+
+	struct namedShape_t {
+		const char * name;
+		Shape * shape;
+	};
+
+	FillDiamond();
+	ShapeBox boxUnit( g_boxUnit, sizeof( g_boxUnit ) / sizeof( Vec3 ) );
+	ShapeBox boxSmall( g_boxSmall, sizeof( g_boxSmall ) / sizeof( Vec3 ) );
+	ShapeBox boxBeam( g_boxBeam, sizeof( g_boxBeam ) / sizeof( Vec3 ) );
+	ShapeConvex diamond( g_diamond, sizeof( g_diamond ) / sizeof( Vec3 ) );
+	ShapeSphere sphere( 0.5f );
+	const namedShape_t shapes[] = {
+		{ "unit box", &boxUnit },
+		{ "small box", &boxSmall },
+		{ "beam", &boxBeam },
+		{ "diamond", &diamond },
+		{ "sphere", &sphere },
+	};
+	const int numShapes = sizeof( shapes ) / sizeof( namedShape_t );
+
+	struct overlap_t {
+		const char * name;
+		float depth;
+	};
+	const overlap_t overlaps[] = {
+		{ "shallow", 0.01f },
+		{ "deep", 0.2f },
+	};
+
+	std::mt19937 generator( 1234 );
+	std::uniform_real_distribution< float > random( -1.0f, 1.0f );
+	auto randomUnit = [ & ]() {
+		Vec3 v;
+		do {
+			v = Vec3( random( generator ), random( generator ), random( generator ) );
+		} while ( v.GetLengthSqr() > 1.0f || v.GetLengthSqr() < 0.01f );
+		v.Normalize();
+		return v;
+	};
+
+	std::vector< Body > bodiesA;
+	std::vector< Body > bodiesB;
+	bodiesA.reserve( numPlacements );
+	bodiesB.reserve( numPlacements );
+
+	printf( "%-10s %-10s %-8s %6s %10s %10s %12s\n", "shape A", "shape B", "overlap", "pairs", "EPA (us)", "MPR (us)", "max diff" );
+	for ( int a = 0; a < numShapes; a++ ) {
+		for ( int b = a; b < numShapes; b++ ) {
+			for ( const overlap_t & overlap : overlaps ) {
+				bodiesA.clear();
+				bodiesB.clear();
+				for ( int i = 0; i < numPlacements; i++ ) {
+					Body bodyA;
+					bodyA.m_shape = shapes[ a ].shape;
+					bodyA.m_position = Vec3( 0.0f );
+					bodyA.m_orientation = Quat( randomUnit(), random( generator ) * acosf( -1.0f ) );
+
+					Body bodyB;
+					bodyB.m_shape = shapes[ b ].shape;
+					bodyB.m_position = Vec3( 0.0f );
+					bodyB.m_orientation = Quat( randomUnit(), random( generator ) * acosf( -1.0f ) );
+
+					// Slide B in along the direction until it touches A, then push it in by the depth. The shapes are apart
+					// once their extents along the direction no longer overlap.
+					const Vec3 dir = randomUnit();
+					const float extentA = bodyA.m_shape->Support( dir, bodyA.m_position, bodyA.m_orientation, 0.0f ).Dot( dir );
+					const float extentB = -bodyB.m_shape->Support( dir * -1.0f, bodyB.m_position, bodyB.m_orientation, 0.0f ).Dot( dir );
+					float touching = 0.0f;
+					float apart = extentA + extentB;
+					for ( int step = 0; step < 20; step++ ) {
+						const float dist = ( touching + apart ) * 0.5f;
+						bodyB.m_position = dir * dist;
+						if ( GJK_DoesIntersect( &bodyA, &bodyB ) ) {
+							touching = dist;
+						} else {
+							apart = dist;
+						}
+					}
+					bodyB.m_position = dir * ( touching - overlap.depth );
+
+					if ( GJK_DoesIntersect( &bodyA, &bodyB ) ) {
+						bodiesA.push_back( bodyA );
+						bodiesB.push_back( bodyB );
+					}
+				}
+				const int numPairs = (int)bodiesA.size();
+				if ( 0 == numPairs ) {
+					continue;
+				}
+
+				float maxDifference = 0.0f;
+				for ( int i = 0; i < numPairs; i++ ) {
+					const float bias = 0.001f;
+					Vec3 ptOnA;
+					Vec3 ptOnB;
+					if ( !GJK_DoesIntersect( &bodiesA[ i ], &bodiesB[ i ], bias, ptOnA, ptOnB ) ) {
+						continue;
+					}
+					const float depthEPA = ( ptOnA - ptOnB ).GetMagnitude() - 2.0f * bias;
+
+					Vec3 normal;
+					float depthMPR = 0.0f;
+					if ( !MPR_Penetration( &bodiesA[ i ], &bodiesB[ i ], normal, depthMPR, ptOnA, ptOnB ) ) {
+						continue;
+					}
+					maxDifference = std::max( maxDifference, fabsf( depthEPA - depthMPR ) );
+				}
+
+				const auto startEPA = std::chrono::high_resolution_clock::now();
+				for ( int repeat = 0; repeat < numRepeats; repeat++ ) {
+					for ( int i = 0; i < numPairs; i++ ) {
+						Vec3 ptOnA;
+						Vec3 ptOnB;
+						GJK_DoesIntersect( &bodiesA[ i ], &bodiesB[ i ], 0.001f, ptOnA, ptOnB );
+						s_sink = ptOnA.x;
+					}
+				}
+				const auto startMPR = std::chrono::high_resolution_clock::now();
+				for ( int repeat = 0; repeat < numRepeats; repeat++ ) {
+					for ( int i = 0; i < numPairs; i++ ) {
+						Vec3 normal;
+						float depth;
+						Vec3 ptOnA;
+						Vec3 ptOnB;
+						MPR_Penetration( &bodiesA[ i ], &bodiesB[ i ], normal, depth, ptOnA, ptOnB );
+						s_sink = ptOnA.x;
+					}
+				}
+				const auto end = std::chrono::high_resolution_clock::now();
+
+				const double numQueries = double( numPairs ) * numRepeats;
+				const double usEPA = std::chrono::duration< double, std::micro >( startMPR - startEPA ).count() / numQueries;
+				const double usMPR = std::chrono::duration< double, std::micro >( end - startMPR ).count() / numQueries;
+				printf( "%-10s %-10s %-8s %6d %10.3f %10.3f %12.5f\n", shapes[ a ].name, shapes[ b ].name, overlap.name, numPairs, usEPA, usMPR, maxDifference );
+			}
+		}
+	}
+}
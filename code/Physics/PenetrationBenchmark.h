@@ -0,0 +1,8 @@
+//
+//	PenetrationBenchmark.h
+//
+#pragma once
+
+// Times GJK and EPA against MPR on overlapping pairs of the shapes in Shapes.cpp and prints the results. Not called
+// by the simulation, the application runs it on request.
+void BenchmarkPenetration();
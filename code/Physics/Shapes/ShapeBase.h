@@ -8,6 +8,11 @@
 #include "../../Math/Bounds.h"
 #include <vector>
 
+// Every shape is a core grown back out by its convex radius, the core being the shape with its faces moved in by the
+// radius. Shapes that only touch or barely overlap still have cores that are apart, so their contact comes from GJK
+// on the cores and only deeper penetrations need EPA.
+static const float DEFAULT_CONVEX_RADIUS = 0.05f;
+
 /*
 ====================================================
 Shape
@@ -15,6 +20,8 @@ Shape
 */
 class Shape {
 public:
+	Shape() : m_convexRadius( 0.0f ) {}
+
 	virtual Mat3 InertiaTensor() const = 0;
 
 	virtual Bounds GetBounds( const Vec3 & pos, const Quat & orient ) const = 0;
@@ -27,13 +34,52 @@ public:
 		SHAPE_SPHERE,
 		SHAPE_BOX,
 		SHAPE_CONVEX,
+
+		NUM_SHAPE_TYPES,
 	};
 	virtual shapeType_t GetType() const = 0;
 
 	virtual Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const = 0;
 
+	// Support point of the core, dir should be normalized. Shapes without a convex radius are their own core.
+	virtual Vec3 SupportCore( const Vec3 & dir, const Vec3 & pos, const Quat & orient ) const { return Support( dir, pos, orient, 0.0f ); }
+
+	// Shapes that search their points for the support start the search at supportIdx and leave the point found in it,
+	// so a caller making coherent queries can pass the last answer back in. Other shapes ignore it.
+	virtual Vec3 SupportFrom( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias, int & /*supportIdx*/ ) const { return Support( dir, pos, orient, bias ); }
+	virtual Vec3 SupportCoreFrom( const Vec3 & dir, const Vec3 & pos, const Quat & orient, int & /*supportIdx*/ ) const { return SupportCore( dir, pos, orient ); }
+	float GetConvexRadius() const { return m_convexRadius; }
+
 	virtual float FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const { return 0.0f; }
 
 protected:
 	Vec3 m_centerOfMass;
+	float m_convexRadius;
 };
+
+/*
+====================================================
+RotateBounds
+
+World space bounds of the local bounds after rotating and translating them. The box is taken as a center and
+half extents, the extents are pushed through the absolute value of the rotation, so the cost doesn't depend on
+how many points the shape has.
+====================================================
+*/
+inline Bounds RotateBounds( const Bounds & localBounds, const Vec3 & pos, const Quat & orient ) {
+	// The rows are the rotated basis vectors, so the rotation of a point is the sum of the rows scaled by its components
+	const Mat3 rotation = orient.ToMat3();
+	const Vec3 center = ( localBounds.mins + localBounds.maxs ) * 0.5f;
+	const Vec3 extents = ( localBounds.maxs - localBounds.mins ) * 0.5f;
+
+	const Vec3 worldCenter = pos + rotation.rows[ 0 ] * center.x + rotation.rows[ 1 ] * center.y + rotation.rows[ 2 ] * center.z;
+	Vec3 worldExtents;
+	for ( int i = 0; i < 3; i++ ) {
+		worldExtents[ i ] = fabsf( rotation.rows[ 0 ][ i ] ) * extents.x + fabsf( rotation.rows[ 1 ][ i ] ) * extents.y + fabsf( rotation.rows[ 2 ][ i ] ) * extents.z;
+	}
+
+	Bounds bounds;
+	bounds.mins = worldCenter - worldExtents;
+	bounds.maxs = worldCenter + worldExtents;
+	return bounds;
+}
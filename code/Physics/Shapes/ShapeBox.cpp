@@ -2,6 +2,7 @@
 //  Shapes.cpp
 //
 #include "ShapeBox.h"
+#include <algorithm>
 
 /*
 ========================================================================================================
@@ -34,6 +35,10 @@ void ShapeBox::Build( const Vec3 * pts, const int num ) {
 	m_points.emplace_back(m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.mins.z);
 
 	m_centerOfMass = (m_bounds.mins + m_bounds.maxs) * 0.5f;
+
+	// Thin boxes get a smaller radius, so that the core keeps some thickness
+	const Vec3 extents = (m_bounds.maxs - m_bounds.mins) * 0.5f;
+	m_convexRadius = std::min(DEFAULT_CONVEX_RADIUS, 0.5f * std::min(extents.x, std::min(extents.y, extents.z)));
 }
 
 /*
@@ -43,19 +48,30 @@ ShapeBox::Support
 */
 Vec3 ShapeBox::Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const {
 	// dir should be normalized
-	Vec3 support_pt = orient.RotatePoint(m_points[0]) + pos;
-	float max_dist = support_pt.Dot(dir);
-	for (int i = 1; i < m_points.size(); i++)
+	// The furthest corner of the box takes the max or the min of every axis depending on the sign of the direction
+	// in the space of the box, so only the winning corner is rotated into world space
+	const Vec3 localDir = orient.Inverse().RotatePoint(dir);
+	Vec3 corner;
+	for (int i = 0; i < 3; i++)
 	{
-		Vec3 candidate = orient.RotatePoint(m_points[i]) + pos;
-		float candidate_dist = candidate.Dot(dir);
-		if (candidate_dist > max_dist)
-		{
-			support_pt = m_points[i];
-			max_dist = candidate_dist;
-		}
+		corner[i] = (localDir[i] > 0.0f) ? m_bounds.maxs[i] : m_bounds.mins[i];
 	}
-	return support_pt + dir * bias;
+	return orient.RotatePoint(corner) + pos + dir * bias;
+}
+
+/*
+====================================================
+ShapeBox::SupportCore
+====================================================
+*/
+Vec3 ShapeBox::SupportCore( const Vec3 & dir, const Vec3 & pos, const Quat & orient ) const {
+	const Vec3 localDir = orient.Inverse().RotatePoint(dir);
+	Vec3 corner;
+	for (int i = 0; i < 3; i++)
+	{
+		corner[i] = (localDir[i] > 0.0f) ? m_bounds.maxs[i] - m_convexRadius : m_bounds.mins[i] + m_convexRadius;
+	}
+	return orient.RotatePoint(corner) + pos;
 }
 
 /*
@@ -92,23 +108,7 @@ ShapeBox::GetBounds
 ====================================================
 */
 Bounds ShapeBox::GetBounds( const Vec3 & pos, const Quat & orient ) const {
-	Vec3 corners[8];
-	corners[0] = Vec3(m_bounds.mins.x, m_bounds.mins.y, m_bounds.mins.z);
-	corners[1] = Vec3(m_bounds.maxs.x, m_bounds.mins.y, m_bounds.mins.z);
-	corners[2] = Vec3(m_bounds.mins.x, m_bounds.maxs.y, m_bounds.mins.z);
-	corners[3] = Vec3(m_bounds.mins.x, m_bounds.mins.y, m_bounds.maxs.z);
-	corners[4] = Vec3(m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.maxs.z);
-	corners[5] = Vec3(m_bounds.mins.x, m_bounds.maxs.y, m_bounds.maxs.z);
-	corners[6] = Vec3(m_bounds.maxs.x, m_bounds.mins.y, m_bounds.maxs.z);
-	corners[7] = Vec3(m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.mins.z);
-
-	Bounds bounds;
-	for (int i = 0; i < 8; i++)
-	{
-		corners[i] = orient.RotatePoint(corners[i]) + pos;
-		bounds.Expand(corners[i]);
-	}
-	return bounds;
+	return RotateBounds(m_bounds, pos, orient);
 }
 
 /*
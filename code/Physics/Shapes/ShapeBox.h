@@ -17,6 +17,7 @@ public:
 	void Build( const Vec3 * pts, const int num );
 
 	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+	Vec3 SupportCore( const Vec3 & dir, const Vec3 & pos, const Quat & orient ) const override;
 
 	Mat3 InertiaTensor() const override;
 
@@ -2,6 +2,11 @@
 //  ShapeConvex.cpp
 //
 #include "ShapeConvex.h"
+#include <map>
+#include <algorithm>
+#include <float.h>
+#include <assert.h>
+#include <xmmintrin.h>
 
 /*
 ========================================================================================================
@@ -318,10 +323,10 @@ void RemoveUnreferencedVertices(std::vector<Vec3>& hull_points, std::vector<tri_
 			{
 				triangle.c--;
 			}
-
-			hull_points.erase(hull_points.begin() + point_index);
-			point_index--;
 		}
+
+		hull_points.erase(hull_points.begin() + point_index);
+		point_index--;
 	}
 }
 
@@ -359,6 +364,223 @@ void BuildConvexHull(const std::vector< Vec3 >& verts, std::vector< Vec3 >& hull
 	ExpandConvexHull(hullPts, hullTris, verts);
 }
 
+/*
+====================================================
+BuildHullFeatures
+
+Merges the coplanar triangles of the hull into faces and collects the edges between the faces
+====================================================
+*/
+void BuildHullFeatures(const std::vector< Vec3 >& hullPts, const std::vector< tri_t >& hullTris, std::vector< hullFace_t >& faces, std::vector< int >& faceIndices, std::vector< hullEdge_t >& edges) {
+	faces.clear();
+	faceIndices.clear();
+	edges.clear();
+
+	// Group the triangles by their normal, on a convex hull triangles facing the same way lie in the same plane
+	const float coplanarTolerance = 0.9999f;
+	std::vector<int> triangle_faces(hullTris.size());
+	std::vector<Vec3> face_normals;
+	for (int i = 0; i < hullTris.size(); i++)
+	{
+		const tri_t& triangle = hullTris[i];
+		Vec3 normal = (hullPts[triangle.b] - hullPts[triangle.a]).Cross(hullPts[triangle.c] - hullPts[triangle.a]);
+		normal.Normalize();
+
+		int face = -1;
+		for (int f = 0; f < face_normals.size(); f++)
+		{
+			if (face_normals[f].Dot(normal) > coplanarTolerance)
+			{
+				face = f;
+				break;
+			}
+		}
+		if (face == -1)
+		{
+			face = (int)face_normals.size();
+			face_normals.push_back(normal);
+		}
+		triangle_faces[i] = face;
+	}
+
+	// The boundary of a face is made of the directed edges whose reverse belongs to another face
+	std::map<std::pair<int, int>, int> edge_faces;
+	for (int i = 0; i < hullTris.size(); i++)
+	{
+		const tri_t& triangle = hullTris[i];
+		edge_faces[std::make_pair(triangle.a, triangle.b)] = triangle_faces[i];
+		edge_faces[std::make_pair(triangle.b, triangle.c)] = triangle_faces[i];
+		edge_faces[std::make_pair(triangle.c, triangle.a)] = triangle_faces[i];
+	}
+
+	std::vector<std::map<int, int>> boundary_next(face_normals.size());
+	for (const auto& edge_face : edge_faces)
+	{
+		const std::pair<int, int>& edge = edge_face.first;
+		const int face = edge_face.second;
+		const auto opposite = edge_faces.find(std::make_pair(edge.second, edge.first));
+		if (opposite == edge_faces.end())
+		{
+			// Only a broken hull has an edge used by a single triangle, leave it out of the features
+			assert(false);
+			continue;
+		}
+
+		const int opposite_face = opposite->second;
+		if (opposite_face == face)
+		{
+			continue;
+		}
+		boundary_next[face][edge.first] = edge.second;
+
+		// Every edge is walked by two faces, only keep it from the side with the lower index
+		if (edge.first < edge.second)
+		{
+			hullEdge_t hull_edge;
+			hull_edge.a = edge.first;
+			hull_edge.b = edge.second;
+			hull_edge.faceA = face;
+			hull_edge.faceB = opposite_face;
+			edges.push_back(hull_edge);
+		}
+	}
+
+	// Walk the boundary of every face to get its points in order
+	faces.resize(face_normals.size());
+	for (int f = 0; f < faces.size(); f++)
+	{
+		hullFace_t& face = faces[f];
+		face.normal = face_normals[f];
+		face.firstIndex = (int)faceIndices.size();
+		face.numIndices = 0;
+		face.distance = -FLT_MAX;
+
+		const std::map<int, int>& next = boundary_next[f];
+		const int start = next.begin()->first;
+		int point = start;
+		do
+		{
+			faceIndices.push_back(point);
+			face.numIndices++;
+			face.distance = std::max(face.distance, face.normal.Dot(hullPts[point]));
+			point = next.at(point);
+		} while (point != start && face.numIndices <= next.size());
+	}
+}
+
+/*
+====================================================
+BuildVertexAdjacency
+
+Links every point to the points it shares a triangle edge with
+====================================================
+*/
+void BuildVertexAdjacency(const int numPts, const std::vector< tri_t >& hullTris, std::vector< int >& adjacencyStart, std::vector< int >& adjacency) {
+	std::vector<std::pair<int, int>> links;
+	links.reserve(hullTris.size() * 6);
+	for (int i = 0; i < hullTris.size(); i++)
+	{
+		const tri_t& triangle = hullTris[i];
+		links.push_back(std::make_pair(triangle.a, triangle.b));
+		links.push_back(std::make_pair(triangle.b, triangle.a));
+		links.push_back(std::make_pair(triangle.b, triangle.c));
+		links.push_back(std::make_pair(triangle.c, triangle.b));
+		links.push_back(std::make_pair(triangle.c, triangle.a));
+		links.push_back(std::make_pair(triangle.a, triangle.c));
+	}
+
+	// Every edge is shared by two triangles
+	std::sort(links.begin(), links.end());
+	links.erase(std::unique(links.begin(), links.end()), links.end());
+
+	adjacencyStart.assign(numPts + 1, 0);
+	adjacency.resize(links.size());
+	for (int i = 0; i < links.size(); i++)
+	{
+		adjacencyStart[links[i].first + 1]++;
+		adjacency[i] = links[i].second;
+	}
+	for (int i = 0; i < numPts; i++)
+	{
+		adjacencyStart[i + 1] += adjacencyStart[i];
+	}
+}
+
+/*
+====================================================
+BuildCorePoints
+
+Moves every point in so that it is the convex radius inside each face it is on. A point on three faces ends up
+where the three moved faces meet, so the core has the same faces and the same normals. A point on more faces can't
+be on all of them and is pushed in until it is inside every one, which leaves the core a little small there.
+Returns the radius, which is lowered for sharp hulls so that no point moves more than half way to the center.
+====================================================
+*/
+float BuildCorePoints(const std::vector< Vec3 >& hullPts, const std::vector< hullFace_t >& faces, const std::vector< int >& faceIndices, const Vec3& center, std::vector< Vec3 >& corePts) {
+	std::vector<std::vector<int>> pointFaces(hullPts.size());
+	for (int i = 0; i < faces.size(); i++)
+	{
+		for (int j = 0; j < faces[i].numIndices; j++)
+		{
+			pointFaces[faceIndices[faces[i].firstIndex + j]].push_back(i);
+		}
+	}
+
+	// The offset of a point moves it a unit into every face it is on
+	std::vector<Vec3> offsets(hullPts.size());
+	float radius = DEFAULT_CONVEX_RADIUS;
+	for (int i = 0; i < hullPts.size(); i++)
+	{
+		const std::vector<int>& adjacent = pointFaces[i];
+		if (adjacent.empty())
+		{
+			offsets[i].Zero();
+			continue;
+		}
+
+		bool isSolved = false;
+		if (adjacent.size() == 3)
+		{
+			// Solve normal.Dot( offset ) = 1 for the three faces
+			const Vec3& n0 = faces[adjacent[0]].normal;
+			const Vec3& n1 = faces[adjacent[1]].normal;
+			const Vec3& n2 = faces[adjacent[2]].normal;
+			const float det = n0.Dot(n1.Cross(n2));
+			if (fabsf(det) > 1e-4f)
+			{
+				offsets[i] = (n1.Cross(n2) + n2.Cross(n0) + n0.Cross(n1)) / det;
+				isSolved = true;
+			}
+		}
+		if (!isSolved)
+		{
+			Vec3 dir(0.0f);
+			for (int j = 0; j < adjacent.size(); j++)
+			{
+				dir += faces[adjacent[j]].normal;
+			}
+			dir.Normalize();
+
+			float minDot = 1.0f;
+			for (int j = 0; j < adjacent.size(); j++)
+			{
+				minDot = std::min(minDot, dir.Dot(faces[adjacent[j]].normal));
+			}
+			offsets[i] = dir / std::max(minDot, 1e-3f);
+		}
+
+		const float maxRadius = 0.5f * (hullPts[i] - center).GetMagnitude() / offsets[i].GetMagnitude();
+		radius = std::min(radius, maxRadius);
+	}
+
+	corePts.resize(hullPts.size());
+	for (int i = 0; i < hullPts.size(); i++)
+	{
+		corePts[i] = hullPts[i] - offsets[i] * radius;
+	}
+	return radius;
+}
+
 bool IsExternal(const std::vector<Vec3>& points, const std::vector<tri_t>& triangles, const Vec3& point)
 {
 	bool is_external = false;
@@ -491,6 +713,23 @@ void ShapeConvex::Build(const Vec3* pts, const int num) {
 	m_centerOfMass = CalculateCenterOfMass(hull_points, hull_triangles);
 
 	m_inertiaTensor = CalculateInertiaTensor(hull_points, hull_triangles, m_centerOfMass);
+
+	BuildHullFeatures(hull_points, hull_triangles, m_faces, m_faceIndices, m_edges);
+	BuildVertexAdjacency((int)m_points.size(), hull_triangles, m_adjacencyStart, m_adjacency);
+
+	m_convexRadius = BuildCorePoints(m_points, m_faces, m_faceIndices, m_centerOfMass, m_corePoints);
+
+	const int numPadded = ((int)m_points.size() + 3) & ~3;
+	m_pointsX.resize(numPadded);
+	m_pointsY.resize(numPadded);
+	m_pointsZ.resize(numPadded);
+	for (int i = 0; i < numPadded; i++)
+	{
+		const Vec3& pt = m_points[std::min(i, (int)m_points.size() - 1)];
+		m_pointsX[i] = pt.x;
+		m_pointsY[i] = pt.y;
+		m_pointsZ[i] = pt.z;
+	}
 }
 
 /*
@@ -499,36 +738,141 @@ ShapeConvex::Support
 ====================================================
 */
 Vec3 ShapeConvex::Support(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias) const {
-	Vec3 supportPt;
+	int supportIdx = 0;
+	return SupportFrom(dir, pos, orient, bias, supportIdx);
+}
 
-	// TODO: Add code
+/*
+====================================================
+ShapeConvex::SupportFrom
+====================================================
+*/
+Vec3 ShapeConvex::SupportFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, const float bias, int& supportIdx) const {
+	// Search in the space of the hull, so only the point that wins is moved into world space
+	const Vec3 localDir = orient.Inverse().RotatePoint(dir);
+	supportIdx = SupportIndex(localDir, supportIdx);
+	const Vec3 supportPt = orient.RotatePoint(m_points[supportIdx]) + pos;
+
+	Vec3 norm = dir;
+	norm.Normalize();
+	return supportPt + norm * bias;
+}
 
-	return supportPt;
+/*
+====================================================
+ShapeConvex::SupportCore
+====================================================
+*/
+Vec3 ShapeConvex::SupportCore(const Vec3& dir, const Vec3& pos, const Quat& orient) const {
+	int supportIdx = 0;
+	return SupportCoreFrom(dir, pos, orient, supportIdx);
 }
 
 /*
 ====================================================
-ShapeConvex::GetBounds
+ShapeConvex::SupportCoreFrom
+
+Moving the faces in keeps their normals, so the core point of the furthest hull point is the furthest core point
 ====================================================
 */
-Bounds ShapeConvex::GetBounds(const Vec3& pos, const Quat& orient) const {
-	Vec3 corners[8];
-	corners[0] = Vec3(m_bounds.mins.x, m_bounds.mins.y, m_bounds.mins.z);
-	corners[1] = Vec3(m_bounds.maxs.x, m_bounds.mins.y, m_bounds.mins.z);
-	corners[2] = Vec3(m_bounds.mins.x, m_bounds.maxs.y, m_bounds.mins.z);
-	corners[3] = Vec3(m_bounds.mins.x, m_bounds.mins.y, m_bounds.maxs.z);
-	corners[4] = Vec3(m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.maxs.z);
-	corners[5] = Vec3(m_bounds.mins.x, m_bounds.maxs.y, m_bounds.maxs.z);
-	corners[6] = Vec3(m_bounds.maxs.x, m_bounds.mins.y, m_bounds.maxs.z);
-	corners[7] = Vec3(m_bounds.maxs.x, m_bounds.maxs.y, m_bounds.mins.z);
+Vec3 ShapeConvex::SupportCoreFrom(const Vec3& dir, const Vec3& pos, const Quat& orient, int& supportIdx) const {
+	const Vec3 localDir = orient.Inverse().RotatePoint(dir);
+	supportIdx = SupportIndex(localDir, supportIdx);
+	return orient.RotatePoint(m_corePoints[supportIdx]) + pos;
+}
 
-	Bounds bounds;
-	for (int i = 0; i < 8; i++)
+/*
+====================================================
+ShapeConvex::SupportIndex
+
+Walks from the start point to the neighbor furthest in the direction until no neighbor is further. The hull is
+convex, so a point with no better neighbor is the furthest point of the hull, whatever point the walk started on.
+====================================================
+*/
+int ShapeConvex::SupportIndex(const Vec3& localDir, const int startIdx) const {
+	if (m_points.size() < MIN_POINTS_FOR_HILL_CLIMB)
 	{
-		corners[i] = orient.RotatePoint(corners[i]) + pos;
-		bounds.Expand(corners[i]);
+		return ScanSupportIndex(localDir);
+	}
+
+	// A start from a cache that was filled for another shape is still a point to start from
+	int idx = (startIdx >= 0 && startIdx < (int)m_points.size()) ? startIdx : 0;
+	float maxDist = localDir.Dot(m_points[idx]);
+	bool didMove = true;
+	while (didMove)
+	{
+		didMove = false;
+		const int current = idx;
+		for (int i = m_adjacencyStart[current]; i < m_adjacencyStart[current + 1]; i++)
+		{
+			const int neighbor = m_adjacency[i];
+			const float dist = localDir.Dot(m_points[neighbor]);
+			if (dist > maxDist)
+			{
+				maxDist = dist;
+				idx = neighbor;
+				didMove = true;
+			}
+		}
 	}
-	return bounds;
+	return idx;
+}
+
+/*
+====================================================
+ShapeConvex::ScanSupportIndex
+
+Tests 4 points at a time, every lane keeps the furthest point it has seen along with its index
+====================================================
+*/
+int ShapeConvex::ScanSupportIndex(const Vec3& localDir) const {
+	const __m128 dirX = _mm_set1_ps(localDir.x);
+	const __m128 dirY = _mm_set1_ps(localDir.y);
+	const __m128 dirZ = _mm_set1_ps(localDir.z);
+	const __m128 four = _mm_set1_ps(4.0f);
+
+	// The indices are kept as floats, which are exact far beyond the size of any hull
+	__m128 indices = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	__m128 maxDists = _mm_set1_ps(-FLT_MAX);
+	__m128 maxIndices = _mm_setzero_ps();
+	for (int i = 0; i < m_pointsX.size(); i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(&m_pointsX[i]);
+		const __m128 y = _mm_loadu_ps(&m_pointsY[i]);
+		const __m128 z = _mm_loadu_ps(&m_pointsZ[i]);
+		const __m128 dists = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, dirX), _mm_mul_ps(y, dirY)), _mm_mul_ps(z, dirZ));
+
+		const __m128 isFurther = _mm_cmpgt_ps(dists, maxDists);
+		maxDists = _mm_or_ps(_mm_and_ps(isFurther, dists), _mm_andnot_ps(isFurther, maxDists));
+		maxIndices = _mm_or_ps(_mm_and_ps(isFurther, indices), _mm_andnot_ps(isFurther, maxIndices));
+		indices = _mm_add_ps(indices, four);
+	}
+
+	float laneDists[4];
+	float laneIndices[4];
+	_mm_storeu_ps(laneDists, maxDists);
+	_mm_storeu_ps(laneIndices, maxIndices);
+
+	int best = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (laneDists[i] > laneDists[best] || (laneDists[i] == laneDists[best] && laneIndices[i] < laneIndices[best]))
+		{
+			best = i;
+		}
+	}
+
+	// The padding repeats the last point
+	return std::min((int)laneIndices[best], (int)m_points.size() - 1);
+}
+
+/*
+====================================================
+ShapeConvex::GetBounds
+====================================================
+*/
+Bounds ShapeConvex::GetBounds(const Vec3& pos, const Quat& orient) const {
+	return RotateBounds(m_bounds, pos, orient);
 }
 
 /*
@@ -19,7 +19,29 @@ struct edge_t {
 	}
 };
 
+// Coplanar triangles of the hull merged into one polygon
+struct hullFace_t {
+	Vec3 normal;		// Outward, in the space of the shape
+	float distance;		// normal.Dot( pt ) for the points of the face
+	int firstIndex;		// The points are m_faceIndices[ firstIndex ] to m_faceIndices[ firstIndex + numIndices - 1 ]
+	int numIndices;		// in counter clockwise order around the normal
+};
+
+// Edge between two faces, the Gauss map of the hull is the arc between the normals of the two faces
+struct hullEdge_t {
+	int a;
+	int b;
+	int faceA;	// Face that walks the edge from a to b
+	int faceB;	// Face that walks the edge from b to a
+};
+
 void BuildConvexHull( const std::vector< Vec3 > & verts, std::vector< Vec3 > & hullPts, std::vector< tri_t > & hullTris );
+void BuildHullFeatures( const std::vector< Vec3 > & hullPts, const std::vector< tri_t > & hullTris, std::vector< hullFace_t > & faces, std::vector< int > & faceIndices, std::vector< hullEdge_t > & edges );
+void BuildVertexAdjacency( const int numPts, const std::vector< tri_t > & hullTris, std::vector< int > & adjacencyStart, std::vector< int > & adjacency );
+float BuildCorePoints( const std::vector< Vec3 > & hullPts, const std::vector< hullFace_t > & faces, const std::vector< int > & faceIndices, const Vec3 & center, std::vector< Vec3 > & corePts );
+
+// Hulls with fewer points are faster to scan than to walk
+static const int MIN_POINTS_FOR_HILL_CLIMB = 32;
 
 /*
 ====================================================
@@ -34,6 +56,9 @@ public:
 	void Build( const Vec3 * pts, const int num );
 
 	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+	Vec3 SupportCore( const Vec3 & dir, const Vec3 & pos, const Quat & orient ) const override;
+	Vec3 SupportFrom( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias, int & supportIdx ) const override;
+	Vec3 SupportCoreFrom( const Vec3 & dir, const Vec3 & pos, const Quat & orient, int & supportIdx ) const override;
 
 	Mat3 InertiaTensor() const override { return m_inertiaTensor; }
 
@@ -42,10 +67,35 @@ public:
 
 	float FastestLinearSpeed( const Vec3 & angularVelocity, const Vec3 & dir ) const override;
 
+	// Index of the point furthest along the direction given in the space of the shape. Walks from startIdx on
+	// hulls large enough for the walk to pay off, so a query that starts from last frame's answer is nearly free.
+	int SupportIndex( const Vec3 & localDir, const int startIdx ) const;
+
 	shapeType_t GetType() const override { return SHAPE_CONVEX; }
 
 public:
 	std::vector< Vec3 > m_points;
 	Bounds m_bounds;
 	Mat3 m_inertiaTensor;
+
+	// m_points moved in to the core, in the same order
+	std::vector< Vec3 > m_corePoints;
+
+	// Features of the hull for the separating axis test
+	std::vector< hullFace_t > m_faces;
+	std::vector< int > m_faceIndices;
+	std::vector< hullEdge_t > m_edges;
+
+	// Neighbors of every point along the hull triangles, the neighbors of point i are
+	// m_adjacency[ m_adjacencyStart[ i ] ] to m_adjacency[ m_adjacencyStart[ i + 1 ] - 1 ]
+	std::vector< int > m_adjacencyStart;
+	std::vector< int > m_adjacency;
+
+	// The points split by component for the SIMD scan, padded to a multiple of 4 with copies of the last point
+	std::vector< float > m_pointsX;
+	std::vector< float > m_pointsY;
+	std::vector< float > m_pointsZ;
+
+private:
+	int ScanSupportIndex( const Vec3 & localDir ) const;
 };
\ No newline at end of file
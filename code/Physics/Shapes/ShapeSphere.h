@@ -13,9 +13,11 @@ class ShapeSphere : public Shape {
 public:
 	explicit ShapeSphere( const float radius ) : m_radius( radius ) {
 		m_centerOfMass.Zero();
+		m_convexRadius = radius;
 	}
 
 	Vec3 Support( const Vec3 & dir, const Vec3 & pos, const Quat & orient, const float bias ) const override;
+	Vec3 SupportCore( const Vec3 & /*dir*/, const Vec3 & pos, const Quat & /*orient*/ ) const override { return pos; }
 
 	Mat3 InertiaTensor() const override;
 
@@ -0,0 +1,294 @@
+//
+//  SpatialHashGrid.cpp
+//
+#include "SpatialHashGrid.h"
+#include "Broadphase.h"
+#include "ThreadPool.h"
+
+int CellCoordinate(const float value, const float invCellSize)
+{
+	return (int)floorf(value * invCellSize);
+}
+
+uint64_t CellKey(const int level, const int x, const int y, const int z)
+{
+	// 20 bits per axis, coordinates that wrap around only merge far away cells which the bounds test rejects
+	const uint64_t mask = 0xFFFFF;
+	return ((uint64_t)level << 60) | (((uint64_t)x & mask) << 40) | (((uint64_t)y & mask) << 20) | ((uint64_t)z & mask);
+}
+
+uint64_t HashCellKey(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/*
+====================================================
+SpatialHashGrid::SpatialHashGrid
+====================================================
+*/
+SpatialHashGrid::SpatialHashGrid() :
+	m_baseCellSize(1.0f),
+	m_occupiedLevels(0)
+{}
+
+/*
+====================================================
+SpatialHashGrid::Clear
+====================================================
+*/
+void SpatialHashGrid::Clear()
+{
+	m_bounds.clear();
+	m_levels.clear();
+	m_occupiedLevels = 0;
+	m_entryKeys.clear();
+	m_entryBodies.clear();
+	m_entryCells.clear();
+	m_hashKeys.clear();
+	m_hashCells.clear();
+	m_cellStart.clear();
+	m_cellBodies.clear();
+}
+
+/*
+====================================================
+SpatialHashGrid::LevelForBounds
+====================================================
+*/
+int SpatialHashGrid::LevelForBounds(const Bounds& bounds) const
+{
+	const float extent = std::max(bounds.WidthX(), std::max(bounds.WidthY(), bounds.WidthZ()));
+
+	int level = 0;
+	while (level < MAX_LEVELS - 1 && CellSize(level) < extent)
+	{
+		level++;
+	}
+	return level;
+}
+
+/*
+====================================================
+SpatialHashGrid::FindCell
+====================================================
+*/
+int SpatialHashGrid::FindCell(const uint64_t key) const
+{
+	const int mask = (int)m_hashKeys.size() - 1;
+	int slot = (int)(HashCellKey(key) & mask);
+	while (m_hashCells[slot] != -1)
+	{
+		if (m_hashKeys[slot] == key)
+		{
+			return m_hashCells[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+/*
+====================================================
+SpatialHashGrid::InsertCell
+
+Returns the index of the cell with the given key, adding a new cell if it doesn't exist yet
+====================================================
+*/
+int SpatialHashGrid::InsertCell(const uint64_t key)
+{
+	const int mask = (int)m_hashKeys.size() - 1;
+	int slot = (int)(HashCellKey(key) & mask);
+	while (m_hashCells[slot] != -1)
+	{
+		if (m_hashKeys[slot] == key)
+		{
+			return m_hashCells[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	const int cell = (int)m_cellStart.size();
+	m_hashKeys[slot] = key;
+	m_hashCells[slot] = cell;
+	m_cellStart.push_back(0);
+	return cell;
+}
+
+/*
+====================================================
+SpatialHashGrid::Update
+====================================================
+*/
+void SpatialHashGrid::Update(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec)
+{
+	m_bounds.resize(num);
+	m_levels.resize(num);
+	m_occupiedLevels = 0;
+	m_entryKeys.clear();
+	m_entryBodies.clear();
+
+	for (int i = 0; i < num; i++)
+	{
+		const Bounds bounds = SweptBounds(bodies[bodyIds[i]], worldBounds.Get(bodyIds[i]), dt_sec);
+
+		const int level = LevelForBounds(bounds);
+		m_bounds[i] = bounds;
+		m_levels[i] = level;
+		m_occupiedLevels |= (1 << level);
+
+		const float invCellSize = 1.0f / CellSize(level);
+		const int minX = CellCoordinate(bounds.mins.x, invCellSize);
+		const int minY = CellCoordinate(bounds.mins.y, invCellSize);
+		const int minZ = CellCoordinate(bounds.mins.z, invCellSize);
+		const int maxX = CellCoordinate(bounds.maxs.x, invCellSize);
+		const int maxY = CellCoordinate(bounds.maxs.y, invCellSize);
+		const int maxZ = CellCoordinate(bounds.maxs.z, invCellSize);
+		for (int x = minX; x <= maxX; x++)
+		{
+			for (int y = minY; y <= maxY; y++)
+			{
+				for (int z = minZ; z <= maxZ; z++)
+				{
+					m_entryKeys.push_back(CellKey(level, x, y, z));
+					m_entryBodies.push_back(i);
+				}
+			}
+		}
+	}
+
+	// Size the hash table to twice the number of entries, which bounds the number of occupied cells
+	const int numEntries = (int)m_entryKeys.size();
+	int capacity = 16;
+	while (capacity < 2 * numEntries)
+	{
+		capacity *= 2;
+	}
+	m_hashKeys.resize(capacity);
+	m_hashCells.assign(capacity, -1);
+	m_cellStart.clear();
+
+	// Count the bodies in every cell
+	m_entryCells.resize(numEntries);
+	for (int e = 0; e < numEntries; e++)
+	{
+		const int cell = InsertCell(m_entryKeys[e]);
+		m_entryCells[e] = cell;
+		m_cellStart[cell]++;
+	}
+
+	// Turn the counts into cell ends, then walk the entries backwards so the starts are left behind and the
+	// bodies of every cell stay in increasing order
+	const int numCells = (int)m_cellStart.size();
+	for (int c = 1; c < numCells; c++)
+	{
+		m_cellStart[c] += m_cellStart[c - 1];
+	}
+	m_cellBodies.resize(numEntries);
+	for (int e = numEntries - 1; e >= 0; e--)
+	{
+		m_cellBodies[--m_cellStart[m_entryCells[e]]] = m_entryBodies[e];
+	}
+	m_cellStart.push_back(numEntries);
+}
+
+/*
+====================================================
+SpatialHashGrid::BuildPairs
+====================================================
+*/
+void SpatialHashGrid::BuildPairs(std::vector<collisionPair_t>& collisionPairs)
+{
+	collisionPairs.clear();
+
+	const int num = (int)m_bounds.size();
+	const int numChunks = ThreadPool::Get().GetNumChunks(num, MIN_BODIES_PER_CHUNK);
+	if (m_pairBuffers.size() < numChunks)
+	{
+		m_pairBuffers.resize(numChunks);
+	}
+
+	// The cells are only read here, so the bodies can be split into contiguous chunks
+	ParallelFor(num, MIN_BODIES_PER_CHUNK, [&](const int begin, const int end, const int chunk)
+	{
+		pairBuffer_t& buffer = m_pairBuffers[chunk];
+		buffer.pairs.clear();
+		buffer.numRejected = 0;
+
+		for (int a = begin; a < end; a++)
+		{
+			const Bounds& boundsA = m_bounds[a];
+			const int levelA = m_levels[a];
+
+			// Bodies of the same level are paired through the shared cells, larger bodies are found by looking up
+			// the coarser levels. Bodies in finer levels will find this one, so they are skipped.
+			for (int level = levelA; level < MAX_LEVELS; level++)
+			{
+				if ((m_occupiedLevels & (1 << level)) == 0)
+				{
+					continue;
+				}
+
+				const float invCellSize = 1.0f / CellSize(level);
+				const int minX = CellCoordinate(boundsA.mins.x, invCellSize);
+				const int minY = CellCoordinate(boundsA.mins.y, invCellSize);
+				const int minZ = CellCoordinate(boundsA.mins.z, invCellSize);
+				const int maxX = CellCoordinate(boundsA.maxs.x, invCellSize);
+				const int maxY = CellCoordinate(boundsA.maxs.y, invCellSize);
+				const int maxZ = CellCoordinate(boundsA.maxs.z, invCellSize);
+				for (int x = minX; x <= maxX; x++)
+				{
+					for (int y = minY; y <= maxY; y++)
+					{
+						for (int z = minZ; z <= maxZ; z++)
+						{
+							const uint64_t key = CellKey(level, x, y, z);
+							const int cell = FindCell(key);
+							if (cell == -1)
+							{
+								continue;
+							}
+
+							for (int i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+							{
+								const int b = m_cellBodies[i];
+								if (level == levelA && b <= a)
+								{
+									continue;
+								}
+
+								const Bounds& boundsB = m_bounds[b];
+								if (!boundsA.DoesIntersect(boundsB))
+								{
+									continue;
+								}
+
+								// Two bodies can share several cells, only report the pair from the cell that holds
+								// the minimum corner of their overlap
+								const int overlapX = CellCoordinate(std::max(boundsA.mins.x, boundsB.mins.x), invCellSize);
+								const int overlapY = CellCoordinate(std::max(boundsA.mins.y, boundsB.mins.y), invCellSize);
+								const int overlapZ = CellCoordinate(std::max(boundsA.mins.z, boundsB.mins.z), invCellSize);
+								if (CellKey(level, overlapX, overlapY, overlapZ) != key)
+								{
+									continue;
+								}
+
+								collisionPair_t pair;
+								pair.a = a;
+								pair.b = b;
+								buffer.pairs.push_back(pair);
+							}
+						}
+					}
+				}
+			}
+		}
+	});
+
+	MergePairBuffers(m_pairBuffers, numChunks, collisionPairs);
+}
@@ -0,0 +1,61 @@
+//
+//	SpatialHashGrid.h
+//
+#pragma once
+#include "../Math/Bounds.h"
+#include "Body.h"
+#include "CollisionPair.h"
+#include <vector>
+#include <stdint.h>
+
+/*
+====================================================
+SpatialHashGrid
+
+Hierarchical hashed grid. Every level doubles the cell size of the previous one and every body is stored in
+the first level whose cells are at least as large as its bounds, so a body never touches more than 8 cells.
+Only occupied cells are stored, in an open addressing hash table that is rebuilt every step.
+====================================================
+*/
+class SpatialHashGrid
+{
+public:
+	SpatialHashGrid();
+
+	void Clear();
+
+	void Update(const Body* bodies, const boundsArray_t& worldBounds, const int* bodyIds, const int num, const float dt_sec);
+	void BuildPairs(std::vector<collisionPair_t>& collisionPairs);
+
+	int GetNumOccupiedCells() const { return (int)m_cellStart.size() - 1; }
+
+	static const int MAX_LEVELS = 16;
+	static const int MIN_BODIES_PER_CHUNK = 256;
+
+	float m_baseCellSize;	// Cell size of the finest level, ideally the size of the smallest bodies
+
+private:
+	int LevelForBounds(const Bounds& bounds) const;
+	float CellSize(const int level) const { return m_baseCellSize * float(1 << level); }
+	int FindCell(const uint64_t key) const;
+	int InsertCell(const uint64_t key);
+
+	std::vector<Bounds> m_bounds;
+	std::vector<int> m_levels;
+	unsigned int m_occupiedLevels;
+
+	// One entry per body per overlapped cell
+	std::vector<uint64_t> m_entryKeys;
+	std::vector<int> m_entryBodies;
+	std::vector<int> m_entryCells;
+
+	// Hash table from cell key to the index of the cell
+	std::vector<uint64_t> m_hashKeys;
+	std::vector<int> m_hashCells;
+
+	// Bodies of cell i are m_cellBodies[ m_cellStart[ i ] ] to m_cellBodies[ m_cellStart[ i + 1 ] - 1 ]
+	std::vector<int> m_cellStart;
+	std::vector<int> m_cellBodies;
+
+	std::vector<pairBuffer_t> m_pairBuffers;
+};
@@ -0,0 +1,171 @@
+//
+//  ThreadPool.cpp
+//
+#include "ThreadPool.h"
+#include <algorithm>
+
+// Set while a thread is running a chunk, nested parallel loops run inline instead of waiting on the pool
+static thread_local bool t_isInsideJob = false;
+
+/*
+====================================================
+ThreadPool::Get
+====================================================
+*/
+ThreadPool& ThreadPool::Get()
+{
+	static ThreadPool pool((int)std::max(1u, std::thread::hardware_concurrency()));
+	return pool;
+}
+
+/*
+====================================================
+ThreadPool::ThreadPool
+====================================================
+*/
+ThreadPool::ThreadPool(const int numThreads) :
+	m_func(nullptr),
+	m_count(0),
+	m_numChunks(0),
+	m_nextChunk(0),
+	m_numBusyWorkers(0),
+	m_generation(0),
+	m_quit(false)
+{
+	for (int i = 1; i < numThreads; i++)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+/*
+====================================================
+ThreadPool::~ThreadPool
+====================================================
+*/
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+/*
+====================================================
+ThreadPool::GetNumChunks
+====================================================
+*/
+int ThreadPool::GetNumChunks(const int count, const int minItemsPerChunk) const
+{
+	if (count <= 0)
+	{
+		return 0;
+	}
+
+	const int maxChunks = std::max(1, count / std::max(1, minItemsPerChunk));
+	return std::min(GetNumThreads(), maxChunks);
+}
+
+/*
+====================================================
+ThreadPool::RunChunks
+====================================================
+*/
+void ThreadPool::RunChunks()
+{
+	t_isInsideJob = true;
+	while (true)
+	{
+		const int chunk = m_nextChunk.fetch_add(1);
+		if (chunk >= m_numChunks)
+		{
+			break;
+		}
+
+		const int begin = (int)((long long)m_count * chunk / m_numChunks);
+		const int end = (int)((long long)m_count * (chunk + 1) / m_numChunks);
+		(*m_func)(begin, end, chunk);
+	}
+	t_isInsideJob = false;
+}
+
+/*
+====================================================
+ThreadPool::WorkerLoop
+====================================================
+*/
+void ThreadPool::WorkerLoop()
+{
+	unsigned int lastGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_quit || m_generation != lastGeneration; });
+			if (m_quit)
+			{
+				return;
+			}
+			lastGeneration = m_generation;
+		}
+
+		RunChunks();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_numBusyWorkers--;
+		}
+		m_done.notify_one();
+	}
+}
+
+/*
+====================================================
+ThreadPool::ParallelFor
+====================================================
+*/
+void ThreadPool::ParallelFor(const int count, const int minItemsPerChunk, const rangeFunc_t& func)
+{
+	const int numChunks = GetNumChunks(count, minItemsPerChunk);
+	if (numChunks == 0)
+	{
+		return;
+	}
+
+	if (numChunks == 1 || m_workers.empty() || t_isInsideJob)
+	{
+		// Keep the same chunking as the threaded path, so results don't depend on how the work was scheduled
+		for (int chunk = 0; chunk < numChunks; chunk++)
+		{
+			const int begin = (int)((long long)count * chunk / numChunks);
+			const int end = (int)((long long)count * (chunk + 1) / numChunks);
+			func(begin, end, chunk);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_func = &func;
+		m_count = count;
+		m_numChunks = numChunks;
+		m_nextChunk = 0;
+		m_numBusyWorkers = (int)m_workers.size();
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	RunChunks();
+
+	// Wait for every worker to leave the job before the function goes out of scope
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&] { return m_numBusyWorkers == 0; });
+	m_func = nullptr;
+}
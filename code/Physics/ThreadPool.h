@@ -0,0 +1,63 @@
+//
+//	ThreadPool.h
+//
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+/*
+====================================================
+ThreadPool
+
+Persistent worker threads for the data parallel parts of the step. The calling thread takes part in the work,
+so a pool with a single thread runs everything inline.
+====================================================
+*/
+class ThreadPool
+{
+public:
+	typedef std::function<void(const int begin, const int end, const int chunkIdx)> rangeFunc_t;
+
+	static ThreadPool& Get();
+
+	~ThreadPool();
+
+	// Number of threads that can work at the same time, including the calling one
+	int GetNumThreads() const { return (int)m_workers.size() + 1; }
+
+	// Returns how many chunks ParallelFor will split the range into
+	int GetNumChunks(const int count, const int minItemsPerChunk) const;
+
+	// Splits [0, count) into GetNumChunks() contiguous chunks and runs them on the pool. Chunk c always covers the
+	// same range for the same count, so per chunk results can be merged in a deterministic order.
+	void ParallelFor(const int count, const int minItemsPerChunk, const rangeFunc_t& func);
+
+private:
+	explicit ThreadPool(const int numThreads);
+
+	void WorkerLoop();
+	void RunChunks();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	// The job that is currently running
+	const rangeFunc_t* m_func;
+	int m_count;
+	int m_numChunks;
+	std::atomic<int> m_nextChunk;
+	int m_numBusyWorkers;
+	unsigned int m_generation;
+	bool m_quit;
+};
+
+inline void ParallelFor(const int count, const int minItemsPerChunk, const ThreadPool::rangeFunc_t& func)
+{
+	ThreadPool::Get().ParallelFor(count, minItemsPerChunk, func);
+}
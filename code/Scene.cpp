@@ -8,6 +8,7 @@
 #include "Physics/Contact.h"
 #include "Physics/Intersections.h"
 #include "Physics/Broadphase.h"
+#include "Physics/ThreadPool.h"
 
 /*
 ========================================================================================================
@@ -97,6 +98,8 @@ void Scene::Reset()
 		delete m_bodies[i].m_shape;
 	}
 	m_bodies.clear();
+	m_broadPhase.Clear();
+	m_narrowphaseCaches.clear();
 
 	Initialize();
 }
@@ -166,90 +169,429 @@ void Scene::Initialize()
 
 /*
 ====================================================
-Scene::Update
+Scene::BindWorldBounds
+
+Points every body at its entry in the world space bounds, bodies that are new since the last step get their
+bounds computed here and keep them up to date themselves from then on
 ====================================================
 */
-void Scene::Update(const float dt_sec)
+void Scene::BindWorldBounds()
 {
-	// Apply gravitational impulse
-	for (int i = 0; i < m_bodies.size(); i++)
+	const int num = (int)m_bodies.size();
+	m_worldBounds.Resize(num);
+
+	for (int i = 0; i < num; i++)
 	{
 		Body& body = m_bodies[i];
-		const float mass = body.m_invMass > 0.0f ? 1.0f / body.m_invMass : 0.0f;
-		const Vec3 gravityImpulse = Vec3(0, 0, -50.0f) * mass * dt_sec;
-		body.ApplyImpulseLinear(gravityImpulse);
+		if (body.m_worldBounds == &m_worldBounds && body.m_worldBoundsIdx == i)
+		{
+			continue;
+		}
+
+		body.m_worldBounds = &m_worldBounds;
+		body.m_worldBoundsIdx = i;
+		body.UpdateWorldBounds();
 	}
+}
 
-	//
-	// Broadphase
-	//
-	std::vector<collisionPair_t> collisionPairs;
-	BroadPhase(m_bodies.data(), (int)m_bodies.size(), collisionPairs, dt_sec);
+/*
+====================================================
+Scene::CollectContacts
 
-	//
-	// Narrowphase
-	//
-	int numContacts = 0;
-	const int maxContacts = m_bodies.size() * m_bodies.size();
-	contact_t* contacts = (contact_t*)_malloca(sizeof(contact_t) * maxContacts);
-	assert(contacts != nullptr);
+Runs the narrowphase of the cached pairs on the thread pool, every chunk of pairs writes into its own buffer. The
+buffers are appended to m_contacts in chunk order, which is the order of the pairs.
+====================================================
+*/
+void Scene::CollectContacts(const float dt_sec)
+{
+	const std::vector<cachedPair_t>& cachedPairs = m_broadPhase.m_pairCache.GetPairs();
+	const int numPairs = (int)cachedPairs.size();
+	const int numChunks = ThreadPool::Get().GetNumChunks(numPairs, MIN_PAIRS_PER_CHUNK);
+	if (m_contactBuffers.size() < numChunks)
+	{
+		m_contactBuffers.resize(numChunks);
+	}
 
-	// Collect all contacts
-	for (int i = 0; i < collisionPairs.size(); i++)
+	ParallelFor(numPairs, MIN_PAIRS_PER_CHUNK, [&](const int begin, const int end, const int chunk)
 	{
-		collisionPair_t& pair = collisionPairs[i];
-		Body& bodyA = m_bodies[pair.a];
-		Body& bodyB = m_bodies[pair.b];
+		contactBuffer_t& buffer = m_contactBuffers[chunk];
+		buffer.contacts.clear();
 
-		if (bodyA.m_invMass == 0.0f && bodyB.m_invMass == 0.0f)
+		for (int i = begin; i < end; i++)
 		{
-			continue;
+			const cachedPair_t& pair = cachedPairs[i];
+			Body& bodyA = m_bodies[pair.a];
+			Body& bodyB = m_bodies[pair.b];
+
+			if (bodyA.m_invMass == 0.0f && bodyB.m_invMass == 0.0f)
+			{
+				continue;
+			}
+
+			contact_t contact;
+			const bool hasContact = (m_ccdMode == CCD_SPECULATIVE)
+				? SpeculativeContact(&bodyA, &bodyB, dt_sec, contact, &m_narrowphaseCaches[pair.id])
+				: Intersect(&bodyA, &bodyB, dt_sec, contact, &m_narrowphaseCaches[pair.id]);
+			if (hasContact)
+			{
+				buffer.contacts.push_back(contact);
+			}
 		}
+	});
 
-		contact_t contact;
-		if (Intersect(&bodyA, &bodyB, dt_sec, contact))
+	m_contacts.clear();
+	for (int chunk = 0; chunk < numChunks; chunk++)
+	{
+		const std::vector<contact_t>& chunkContacts = m_contactBuffers[chunk].contacts;
+		m_contacts.insert(m_contacts.end(), chunkContacts.begin(), chunkContacts.end());
+	}
+}
+
+/*
+====================================================
+Scene::BuildBodyPairs
+
+Lists the cached pairs of every body, so the pairs of a body that was just hit can be found without a search
+====================================================
+*/
+void Scene::BuildBodyPairs()
+{
+	const std::vector<cachedPair_t>& cachedPairs = m_broadPhase.m_pairCache.GetPairs();
+	const int numBodies = (int)m_bodies.size();
+
+	m_bodyPairOffsets.assign(numBodies + 1, 0);
+	for (int i = 0; i < cachedPairs.size(); i++)
+	{
+		m_bodyPairOffsets[cachedPairs[i].a + 1]++;
+		m_bodyPairOffsets[cachedPairs[i].b + 1]++;
+	}
+	for (int i = 0; i < numBodies; i++)
+	{
+		m_bodyPairOffsets[i + 1] += m_bodyPairOffsets[i];
+	}
+
+	// Every body writes from its own offset on, which leaves each offset at the start of the next body
+	m_bodyPairs.resize(m_bodyPairOffsets[numBodies]);
+	for (int i = 0; i < cachedPairs.size(); i++)
+	{
+		m_bodyPairs[m_bodyPairOffsets[cachedPairs[i].a]++] = i;
+		m_bodyPairs[m_bodyPairOffsets[cachedPairs[i].b]++] = i;
+	}
+	for (int i = numBodies; i > 0; i--)
+	{
+		m_bodyPairOffsets[i] = m_bodyPairOffsets[i - 1];
+	}
+	m_bodyPairOffsets[0] = 0;
+}
+
+/*
+====================================================
+Scene::QueueTimeOfImpactEvent
+====================================================
+*/
+void Scene::QueueTimeOfImpactEvent(const contact_t& contact, const int bodyA, const int bodyB)
+{
+	toiEvent_t event;
+	event.timeOfImpact = contact.timeOfImpact;
+	event.contactIdx = (int)m_toiContacts.size();
+	event.bodyA = bodyA;
+	event.bodyB = bodyB;
+	event.stampA = m_bodyStamps[bodyA];
+	event.stampB = m_bodyStamps[bodyB];
+
+	m_toiContacts.push_back(contact);
+	m_toiEvents.push_back(event);
+	std::push_heap(m_toiEvents.begin(), m_toiEvents.end());
+}
+
+/*
+====================================================
+Scene::RequeuePair
+
+The other body of the pair may still be at an earlier time, so the query runs on copies of both bodies moved to the
+given time. The copies are not where the bodies were when the narrowphase cache of the pair was filled, so they get
+an empty cache of their own instead.
+====================================================
+*/
+void Scene::RequeuePair(const int bodyIdxA, const int bodyIdxB, const float time, const float dt_sec)
+{
+	Body& liveA = m_bodies[bodyIdxA];
+	Body& liveB = m_bodies[bodyIdxB];
+	if (liveA.m_invMass == 0.0f && liveB.m_invMass == 0.0f)
+	{
+		return;
+	}
+
+	Body bodyA = liveA.Predicted(time - m_bodyTimes[bodyIdxA]);
+	Body bodyB = liveB.Predicted(time - m_bodyTimes[bodyIdxB]);
+
+	narrowphaseCache_t cache;
+	cache.Clear();
+
+	contact_t contact;
+	if (!Intersect(&bodyA, &bodyB, dt_sec - time, contact, &cache))
+	{
+		return;
+	}
+	if (contact.timeOfImpact == 0.0f)
+	{
+		return;
+	}
+
+	contact.bodyA = &liveA;
+	contact.bodyB = &liveB;
+	contact.timeOfImpact += time;
+	QueueTimeOfImpactEvent(contact, bodyIdxA, bodyIdxB);
+}
+
+/*
+====================================================
+Scene::RequeuePairsOf
+
+Finds the time of impact of every pair of a body whose velocity just changed, from the given time to the end of the
+frame. Only impacts still ahead are queued, pairs that touch already are left to the contacts of the next frame,
+like the resting contacts. Resolving those again would pass the impulses around a pile of resting bodies for the
+rest of the frame.
+
+The cached pairs are those of the swept bounds the broadphase saw. A body whose new sweep leaves its old one may
+reach bodies it has no pair with, so it is tested against the sweeps of all the bodies instead, and keeps being
+tested by the others for the rest of the frame.
+====================================================
+*/
+void Scene::RequeuePairsOf(const int bodyIdx, const int skipIdx, const float time, const float dt_sec)
+{
+	const Bounds sweptBounds = SweptBounds(m_bodies[bodyIdx], m_worldBounds.Get(bodyIdx), dt_sec - time);
+	if (!m_sweptBounds[bodyIdx].Contains(sweptBounds))
+	{
+		m_sweptBounds[bodyIdx] = sweptBounds;
+		if (!m_hasEscaped[bodyIdx])
 		{
-			contacts[numContacts++] = contact;
+			m_hasEscaped[bodyIdx] = true;
+			m_escapedBodies.push_back(bodyIdx);
 		}
+
+		for (int i = 0; i < m_bodies.size(); i++)
+		{
+			if (i != bodyIdx && i != skipIdx && sweptBounds.DoesIntersect(m_sweptBounds[i]))
+			{
+				RequeuePair(std::min(i, bodyIdx), std::max(i, bodyIdx), time, dt_sec);
+			}
+		}
+		return;
 	}
 
-	// Sort all contacts based on time of impact from earlieast to latest
-	if (numContacts > 1)
+	// Bodies that escaped their sweeps are tested below, whether they have a pair with this body or not
+	const std::vector<cachedPair_t>& cachedPairs = m_broadPhase.m_pairCache.GetPairs();
+	for (int i = m_bodyPairOffsets[bodyIdx]; i < m_bodyPairOffsets[bodyIdx + 1]; i++)
 	{
-		std::qsort(contacts, numContacts, sizeof(contact_t), CompareContacts);
+		const cachedPair_t& pair = cachedPairs[m_bodyPairs[i]];
+		const int otherIdx = (pair.a == bodyIdx) ? pair.b : pair.a;
+		if (otherIdx != skipIdx && !m_hasEscaped[otherIdx])
+		{
+			RequeuePair(pair.a, pair.b, time, dt_sec);
+		}
 	}
 
-	// Move the system from the current state to the earliest time of impact and so on until all of the
-	// contacts are resolved
-	float accumulatedTime = 0.0f;
+	for (int i = 0; i < m_escapedBodies.size(); i++)
+	{
+		const int otherIdx = m_escapedBodies[i];
+		if (otherIdx != bodyIdx && otherIdx != skipIdx && sweptBounds.DoesIntersect(m_sweptBounds[otherIdx]))
+		{
+			RequeuePair(std::min(otherIdx, bodyIdx), std::max(otherIdx, bodyIdx), time, dt_sec);
+		}
+	}
+}
+
+/*
+====================================================
+Scene::SolveTimeOfImpactEvents
+
+Resolves the contacts in order of their time of impact. Every body keeps its own time, an event only moves its own
+two bodies up to it, the rest of the scene stays where it is. Resolving an event changes the velocities of its
+bodies, so the events they had queued are dropped and their pairs are tested again from the time of the event.
+Static bodies never change, their other pairs are left alone.
+
+Once a frame has resolved as many events as it may, the events still queued are resolved without testing the
+pairs again. The bodies of later impacts may pass into each other then, but none is skipped.
+====================================================
+*/
+void Scene::SolveTimeOfImpactEvents(const contact_t* contacts, const int numContacts, const float dt_sec)
+{
+	const int numBodies = (int)m_bodies.size();
+	m_bodyTimes.assign(numBodies, 0.0f);
+	m_bodyStamps.assign(numBodies, 0);
+	m_toiEvents.clear();
+	m_toiContacts.clear();
+	BuildBodyPairs();
+
+	m_sweptBounds.resize(numBodies);
+	for (int i = 0; i < numBodies; i++)
+	{
+		m_sweptBounds[i] = SweptBounds(m_bodies[i], m_worldBounds.Get(i), dt_sec);
+	}
+	m_hasEscaped.assign(numBodies, false);
+	m_escapedBodies.clear();
+
 	for (int i = 0; i < numContacts; i++)
 	{
-		const contact_t& c = contacts[i];
+		const int bodyA = (int)(contacts[i].bodyA - m_bodies.data());
+		const int bodyB = (int)(contacts[i].bodyB - m_bodies.data());
+		QueueTimeOfImpactEvent(contacts[i], bodyA, bodyB);
+	}
 
-		const float dt = c.timeOfImpact - accumulatedTime;
+	const int maxEvents = numContacts + MAX_TOI_EVENTS_PER_BODY * numBodies;
+	int numEvents = 0;
+	while (!m_toiEvents.empty())
+	{
+		std::pop_heap(m_toiEvents.begin(), m_toiEvents.end());
+		const toiEvent_t event = m_toiEvents.back();
+		m_toiEvents.pop_back();
 
-		if (c.bodyA->m_invMass == 0.0f && c.bodyB->m_invMass == 0.0f)
+		if (event.stampA != m_bodyStamps[event.bodyA] || event.stampB != m_bodyStamps[event.bodyB])
 		{
 			continue;
 		}
 
-		// Position update until time of impact
-		for (Body& body : m_bodies)
+		const int eventBodies[2] = { event.bodyA, event.bodyB };
+		for (int i = 0; i < 2; i++)
+		{
+			const int idx = eventBodies[i];
+			if (event.timeOfImpact > m_bodyTimes[idx])
+			{
+				m_bodies[idx].Update(event.timeOfImpact - m_bodyTimes[idx]);
+				m_bodyTimes[idx] = event.timeOfImpact;
+			}
+		}
+
+		ResolveContact(m_toiContacts[event.contactIdx]);
+		numEvents++;
+		if (numEvents == maxEvents)
+		{
+			m_numCappedFrames++;
+		}
+
+		// The new velocities may make a body fast enough to need sweeps for the rest of the frame, or no longer
+		for (int i = 0; i < 2; i++)
+		{
+			const int idx = eventBodies[i];
+			if (m_bodies[idx].m_invMass != 0.0f)
+			{
+				m_bodyStamps[idx]++;
+				m_bodies[idx].UpdateUseCCD(dt_sec - event.timeOfImpact);
+			}
+		}
+
+		if (numEvents >= maxEvents)
+		{
+			continue;
+		}
+
+		// The pair of the event is part of the pairs of both bodies, it only has to be tested once
+		if (m_bodies[event.bodyA].m_invMass != 0.0f)
+		{
+			RequeuePairsOf(event.bodyA, -1, event.timeOfImpact, dt_sec);
+		}
+		if (m_bodies[event.bodyB].m_invMass != 0.0f)
+		{
+			RequeuePairsOf(event.bodyB, (m_bodies[event.bodyA].m_invMass != 0.0f) ? event.bodyA : -1, event.timeOfImpact, dt_sec);
+		}
+	}
+
+	// Move every body from its own time to the end of the frame
+	for (int i = 0; i < numBodies; i++)
+	{
+		const float remainingTime = dt_sec - m_bodyTimes[i];
+		if (remainingTime > 0.0f)
+		{
+			m_bodies[i].Update(remainingTime);
+		}
+	}
+}
+
+/*
+====================================================
+Scene::SolveSpeculativeContacts
+
+Every pass goes over all the contacts, so the impulse of a contact also answers what the contacts after it did to
+its bodies. Bodies resting on others get the weight of the whole stack this way instead of only their own.
+====================================================
+*/
+void Scene::SolveSpeculativeContacts(const float dt_sec)
+{
+	const int numContacts = (int)m_contacts.size();
+	m_speculativeContacts.resize(numContacts);
+	for (int i = 0; i < numContacts; i++)
+	{
+		PrepareSpeculativeContact(m_contacts[i], dt_sec, m_speculativeContacts[i]);
+	}
+
+	for (int pass = 0; pass < SPECULATIVE_SOLVER_PASSES; pass++)
+	{
+		for (int i = 0; i < numContacts; i++)
 		{
-			body.Update(dt);
+			SolveSpeculativeContact(m_speculativeContacts[i]);
 		}
+	}
 
-		ResolveContact(c);
-		accumulatedTime += dt;
+	for (int i = 0; i < numContacts; i++)
+	{
+		if (m_contacts[i].separationDistance < 0.0f)
+		{
+			ResolvePenetration(m_contacts[i]);
+		}
 	}
+}
 
-	// If there is any time left in the frame, update the system to the end of the frame
-	const float remainingTime = dt_sec - accumulatedTime;
-	if (remainingTime > 0.0f)
+/*
+====================================================
+Scene::Update
+====================================================
+*/
+void Scene::Update(const float dt_sec)
+{
+	BindWorldBounds();
+
+	// Apply gravitational impulse
+	for (int i = 0; i < m_bodies.size(); i++)
+	{
+		Body& body = m_bodies[i];
+		const float mass = body.m_invMass > 0.0f ? 1.0f / body.m_invMass : 0.0f;
+		const Vec3 gravityImpulse = Vec3(0, 0, -50.0f) * mass * dt_sec;
+		body.ApplyImpulseLinear(gravityImpulse);
+		body.UpdateUseCCD(dt_sec);
+	}
+
+	//
+	// Broadphase
+	//
+	std::vector<collisionPair_t> collisionPairs;
+	BroadPhase(m_broadPhase, m_bodies.data(), m_worldBounds, (int)m_bodies.size(), collisionPairs, dt_sec);
+
+	// Pairs that just started overlapping may reuse the id of an ended pair, so they start from an empty cache
+	const std::vector<cachedPair_t>& newPairs = m_broadPhase.m_pairCache.GetNewPairs();
+	m_narrowphaseCaches.resize(m_broadPhase.m_pairCache.GetIdCapacity());
+	for (int i = 0; i < newPairs.size(); i++)
 	{
+		m_narrowphaseCaches[newPairs[i].id].Clear();
+	}
+
+	//
+	// Narrowphase
+	//
+	CollectContacts(dt_sec);
+	const int numContacts = (int)m_contacts.size();
+
+	if (m_ccdMode == CCD_SPECULATIVE)
+	{
+		SolveSpeculativeContacts(dt_sec);
+
+		// The contacts only let the bodies close their gaps, so one update takes everything to the end of the frame
 		for (Body& body : m_bodies)
 		{
-			body.Update(remainingTime);
+			body.Update(dt_sec);
 		}
+		return;
 	}
+
+	SolveTimeOfImpactEvents(m_contacts.data(), numContacts, dt_sec);
 }
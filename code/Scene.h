@@ -8,6 +8,8 @@
 #include "Physics/Body.h"
 #include "Physics/Constraints.h"
 #include "Physics/Manifold.h"
+#include "Physics/Broadphase.h"
+#include "Physics/NarrowphaseCache.h"
 
 /*
 ====================================================
@@ -17,15 +19,63 @@ Scene
 class Scene
 {
 public:
-	Scene() { m_bodies.reserve( 128 ); }
+	Scene() : m_ccdMode( CCD_TIME_OF_IMPACT ), m_numCappedFrames( 0 ) { m_bodies.reserve( 128 ); }
 	~Scene();
 
 	void Reset();
 	void Initialize();
 	void Update( const float dt_sec );	
 
+	// How fast bodies are kept from passing through each other, can be switched between steps
+	enum ccdMode_t {
+		CCD_TIME_OF_IMPACT,	// Contacts are resolved in order of their time of impact, every body is advanced to each one
+		CCD_SPECULATIVE,	// Contacts are built before the bodies touch and solved at once, then the bodies move once
+	};
+	ccdMode_t m_ccdMode;
+
 	std::vector< Body > m_bodies;
+	boundsArray_t m_worldBounds;	// World space bounds of m_bodies, the bodies refresh their own entry as they move
 	std::vector< Constraint * >	m_constraints;
 	ManifoldCollector m_manifolds;
+	BroadPhaseContext m_broadPhase;
+	std::vector< narrowphaseCache_t > m_narrowphaseCaches;	// Indexed by the pair ids of the broadphase pair cache
+	std::vector< contactBuffer_t > m_contactBuffers;	// One per chunk of the parallel narrowphase, kept to reuse their memory
+	std::vector< contact_t > m_contacts;	// Contacts of the frame, the chunk buffers merged in the order of the pairs
+	std::vector< speculativeContact_t > m_speculativeContacts;	// Solver state of m_contacts in the speculative mode
+
+	// Smallest range of pairs that is worth handing to another thread
+	static const int MIN_PAIRS_PER_CHUNK = 32;
+	// Passes of the speculative solver over all the contacts of a frame
+	static const int SPECULATIVE_SOLVER_PASSES = 8;
+	// Events a frame may resolve per body on top of the contacts found at its start, the rest of the queue is resolved
+	// without testing the pairs again after that. Bodies squeezed between others could otherwise hand the same impulse
+	// back and forth for a long time.
+	static const int MAX_TOI_EVENTS_PER_BODY = 16;
+
+	// Number of frames that ran into the limit above since the scene was created
+	int GetNumCappedFrames() const { return m_numCappedFrames; }
+
+private:
+	void BindWorldBounds();
+	void CollectContacts( const float dt_sec );
+	void SolveSpeculativeContacts( const float dt_sec );
+
+	void SolveTimeOfImpactEvents( const contact_t * contacts, const int numContacts, const float dt_sec );
+	void QueueTimeOfImpactEvent( const contact_t & contact, const int bodyA, const int bodyB );
+	void RequeuePairsOf( const int bodyIdx, const int skipIdx, const float time, const float dt_sec );
+	void RequeuePair( const int bodyIdxA, const int bodyIdxB, const float time, const float dt_sec );
+	void BuildBodyPairs();
+
+	// State of the time of impact queue, kept to reuse the memory between frames
+	std::vector< toiEvent_t > m_toiEvents;	// Heap with the earliest event on top
+	std::vector< contact_t > m_toiContacts;
+	std::vector< float > m_bodyTimes;	// How far into the frame every body has been moved
+	std::vector< int > m_bodyStamps;	// Changed every time a contact of the body is resolved
+	std::vector< int > m_bodyPairOffsets;	// The cached pairs of body i are m_bodyPairs[ offsets[ i ], offsets[ i + 1 ] )
+	std::vector< int > m_bodyPairs;
+	std::vector< Bounds > m_sweptBounds;	// Rest of the motion of every body, from the broadphase or its last escape
+	std::vector< bool > m_hasEscaped;	// Set once an impulse sent the body out of its swept bounds
+	std::vector< int > m_escapedBodies;	// The bodies with m_hasEscaped set, in the order they escaped
+	int m_numCappedFrames;
 };
 
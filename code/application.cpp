@@ -16,6 +16,7 @@
 #include "Renderer/OffscreenRenderer.h"
 
 #include "Scene.h"
+#include "Physics/PenetrationBenchmark.h"
 
 Application * g_application = NULL;
 
@@ -441,6 +442,9 @@ void Application::Keyboard( int key, int scancode, int action, int modifiers ) {
 	if ( GLFW_KEY_Y == key && ( GLFW_PRESS == action || GLFW_REPEAT == action ) ) {
 		m_stepFrame = m_isPaused && !m_stepFrame;
 	}
+	if ( GLFW_KEY_B == key && GLFW_RELEASE == action ) {
+		BenchmarkPenetration();
+	}
 }
 
 /*